@@ -0,0 +1,77 @@
+/* dedup.c */
+
+#include "dedup.h"
+#include <string.h>
+
+struct origin {
+  uint8_t  id;
+  uint8_t  last_seq;    /* newest seq seen */
+  uint8_t  age;         /* 0 = most recently used */
+  uint8_t  used;
+  uint32_t seen;        /* bit k: last_seq - k was seen */
+};
+
+static struct origin origins[DEDUP_ORIGINS];
+
+struct dedup_stats dedup_stats;
+
+/*---------------------------------------------------------------------------*/
+void
+dedup_init(void)
+{
+  memset(origins, 0, sizeof(origins));
+  memset(&dedup_stats, 0, sizeof(dedup_stats));
+}
+/*---------------------------------------------------------------------------*/
+static struct origin *
+lookup(uint8_t id)
+{
+  struct origin *o, *victim = &origins[0];
+
+  for(o = origins; o < &origins[DEDUP_ORIGINS]; o++) {
+    if(o->used && o->id == id) {
+      break;
+    }
+    if(!o->used || (victim->used && o->age > victim->age)) {
+      victim = o;
+    }
+  }
+  if(o == &origins[DEDUP_ORIGINS]) {
+    /* forget the least recently heard origin */
+    o = victim;
+    o->id = id;
+    o->used = 1;
+    o->seen = 0;
+  }
+  /* age everyone else, saturating */
+  for(struct origin *p = origins; p < &origins[DEDUP_ORIGINS]; p++) {
+    if(p != o && p->age < 0xFF) {
+      p->age++;
+    }
+  }
+  o->age = 0;
+  return o;
+}
+/*---------------------------------------------------------------------------*/
+int
+dedup_check(uint8_t origin, uint8_t seq)
+{
+  struct origin *o = lookup(origin);
+  uint8_t ahead = (uint8_t)(seq - o->last_seq);
+
+  uint8_t behind = (uint8_t)(o->last_seq - seq);
+
+  if(o->seen == 0 || (ahead != 0 && (ahead < 128 || behind >= 32))) {
+    /* newer than anything seen (or a restart): slide the window */
+    o->seen = (o->seen == 0 || ahead >= 32) ? 1 : (o->seen << ahead) | 1;
+    o->last_seq = seq;
+  } else if(o->seen & ((uint32_t)1 << behind)) {
+    dedup_stats.duplicates++;
+    return 0;
+  } else {
+    o->seen |= (uint32_t)1 << behind;
+  }
+  dedup_stats.fresh++;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,30 @@
+/* dedup.h */
+
+#ifndef DEDUP_H_
+#define DEDUP_H_
+
+#include <stdint.h>
+
+/* Origins whose recent sequence numbers are remembered */
+#ifdef DEDUP_CONF_ORIGINS
+#define DEDUP_ORIGINS  DEDUP_CONF_ORIGINS
+#else
+#define DEDUP_ORIGINS  32
+#endif
+
+struct dedup_stats {
+  uint32_t fresh;       /* (origin, seq) pairs seen for the first time */
+  uint32_t duplicates;  /* pairs seen before and rejected */
+};
+extern struct dedup_stats dedup_stats;
+
+void dedup_init(void);
+
+/*
+ * Record (origin, seq) and return 1 if it was not seen before, 0 for a
+ * duplicate. The last 32 sequence numbers of each origin are tracked; a
+ * seq further behind than that is taken as the origin having restarted.
+ */
+int  dedup_check(uint8_t origin, uint8_t seq);
+
+#endif /* DEDUP_H_ */
@@ -0,0 +1,183 @@
+/* fwd-queue.c */
+
+#include "fwd-queue.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include <string.h>
+
+struct fwd_frame {
+  struct fwd_frame *next;
+  linkaddr_t        dest;       /* while with the MAC */
+  uint16_t          len;
+  uint8_t           tries;      /* transmissions not acked */
+  uint8_t           data[FWD_QUEUE_FRAME_LEN];
+};
+
+MEMB(frames_memb, struct fwd_frame, FWD_QUEUE_LEN);
+LIST(frames);
+
+static struct ctimer          drain_timer;
+static const linkaddr_t      *fwd_dest;
+static fwd_queue_sent_fn      fwd_sent;
+static fwd_queue_gate_fn      fwd_gate;
+static fwd_queue_status_fn    fwd_status;
+static fwd_queue_hop_fn       fwd_hop;
+static fwd_queue_hold_fn      fwd_hold;
+static linkaddr_t             hop;      /* head frame's, null: not chosen */
+
+struct fwd_queue_stats fwd_queue_stats;
+
+/*---------------------------------------------------------------------------*/
+static void drain(void *ptr);
+
+/* A frame is freed once acked; otherwise it is sent again, first */
+static void
+mac_sent(void *ptr, int status, int transmissions)
+{
+  struct fwd_frame *f = ptr;
+  linkaddr_t dest;
+
+  linkaddr_copy(&dest, &f->dest);
+  if(fwd_hold) {
+    fwd_hold(0);
+  }
+  if(status != MAC_TX_OK && ++f->tries < FWD_QUEUE_TRIES) {
+    list_push(frames, f);
+    linkaddr_copy(&hop, &linkaddr_null);
+    fwd_queue_stats.requeued++;
+    ctimer_set(&drain_timer, FWD_QUEUE_RETRY_DELAY, drain, NULL);
+  } else {
+    if(status != MAC_TX_OK) {
+      fwd_queue_stats.tx_drops++;
+    }
+    memb_free(&frames_memb, f);
+  }
+  /* may pick a new parent, and kick the queue towards it */
+  if(fwd_status) {
+    fwd_status(&dest, status, transmissions);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+drain(void *ptr)
+{
+  struct fwd_frame *f = list_head(frames);
+  clock_time_t wait;
+  uint16_t len;
+
+  if(f == NULL) {
+    return;
+  }
+  if(linkaddr_cmp(&hop, &linkaddr_null)) {
+    linkaddr_copy(&hop, fwd_hop ? fwd_hop() : fwd_dest);
+    if(linkaddr_cmp(&hop, &linkaddr_null)) {
+      return;
+    }
+  }
+  wait = fwd_gate ? fwd_gate(&hop) : 0;
+  if(wait > 0) {
+    ctimer_set(&drain_timer, wait, drain, NULL);
+    return;
+  }
+  list_remove(frames, f);
+  /* what nullnet does, but keeping the MAC callback */
+  linkaddr_copy(&f->dest, &hop);
+  linkaddr_copy(&hop, &linkaddr_null);
+  len = f->len;
+  packetbuf_clear();
+  packetbuf_copyfrom(f->data, f->len);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &f->dest);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
+  if(fwd_hold) {
+    fwd_hold(1);
+  }
+  /* f stays ours until mac_sent, which may come before this returns */
+  NETSTACK_MAC.send(mac_sent, f);
+  fwd_queue_stats.sent++;
+  if(fwd_sent) {
+    fwd_sent(len);
+  }
+  if(list_head(frames) != NULL && ctimer_expired(&drain_timer)) {
+    ctimer_set(&drain_timer, FWD_QUEUE_TX_GAP, drain, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+fwd_queue_init(const linkaddr_t *dest, fwd_queue_sent_fn sent)
+{
+  memb_init(&frames_memb);
+  list_init(frames);
+  fwd_dest = dest;
+  fwd_sent = sent;
+  fwd_gate = NULL;
+  fwd_status = NULL;
+  fwd_hop = NULL;
+  fwd_hold = NULL;
+  linkaddr_copy(&hop, &linkaddr_null);
+  memset(&fwd_queue_stats, 0, sizeof(fwd_queue_stats));
+}
+/*---------------------------------------------------------------------------*/
+void
+fwd_queue_set_gate(fwd_queue_gate_fn gate)
+{
+  fwd_gate = gate;
+}
+/*---------------------------------------------------------------------------*/
+void
+fwd_queue_set_next_hop(fwd_queue_hop_fn next_hop)
+{
+  fwd_hop = next_hop;
+}
+/*---------------------------------------------------------------------------*/
+void
+fwd_queue_set_status(fwd_queue_status_fn status)
+{
+  fwd_status = status;
+}
+/*---------------------------------------------------------------------------*/
+void
+fwd_queue_set_hold(fwd_queue_hold_fn hold)
+{
+  fwd_hold = hold;
+}
+/*---------------------------------------------------------------------------*/
+int
+fwd_queue_push(const void *data, uint16_t len)
+{
+  struct fwd_frame *f;
+
+  if(len > FWD_QUEUE_FRAME_LEN) {
+    return 0;
+  }
+  f = memb_alloc(&frames_memb);
+  if(f == NULL) {
+    /* bounded: make room by dropping the oldest frame */
+    f = list_pop(frames);
+    fwd_queue_stats.overflows++;
+    if(f == NULL) {
+      /* every slot is with the MAC: drop this one */
+      return 0;
+    }
+  }
+  memcpy(f->data, data, len);
+  f->len = len;
+  f->tries = 0;
+  list_add(frames, f);
+  if(ctimer_expired(&drain_timer)) {
+    drain(NULL);
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+fwd_queue_kick(void)
+{
+  /* send right away unless a paced drain is already pending */
+  linkaddr_copy(&hop, &linkaddr_null);
+  if(ctimer_expired(&drain_timer)) {
+    drain(NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,97 @@
+/* fwd-queue.h */
+
+#ifndef FWD_QUEUE_H_
+#define FWD_QUEUE_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+/* Frames waiting for the parent; the oldest is dropped on overflow */
+#ifdef FWD_QUEUE_CONF_LEN
+#define FWD_QUEUE_LEN        FWD_QUEUE_CONF_LEN
+#else
+#define FWD_QUEUE_LEN        8
+#endif
+
+/* Largest frame the queue holds */
+#ifdef FWD_QUEUE_CONF_FRAME_LEN
+#define FWD_QUEUE_FRAME_LEN  FWD_QUEUE_CONF_FRAME_LEN
+#else
+#define FWD_QUEUE_FRAME_LEN  80
+#endif
+
+/*
+ * Transmissions of one frame without an ack before it is dropped. A frame
+ * is kept until the MAC reports it acked; one that was not goes back to
+ * the head of the queue, to whichever hop is chosen next.
+ */
+#ifdef FWD_QUEUE_CONF_TRIES
+#define FWD_QUEUE_TRIES      FWD_QUEUE_CONF_TRIES
+#else
+#define FWD_QUEUE_TRIES      4
+#endif
+
+/* Wait before sending an unacked frame again, past a duty-cycled
+   receiver's window, and time for the tree to pick another hop */
+#ifdef FWD_QUEUE_CONF_RETRY_DELAY
+#define FWD_QUEUE_RETRY_DELAY FWD_QUEUE_CONF_RETRY_DELAY
+#else
+#define FWD_QUEUE_RETRY_DELAY CLOCK_SECOND
+#endif
+
+/* Gap between two queued frames so the MAC queue is never overrun */
+#ifdef FWD_QUEUE_CONF_TX_GAP
+#define FWD_QUEUE_TX_GAP     FWD_QUEUE_CONF_TX_GAP
+#else
+#define FWD_QUEUE_TX_GAP     (CLOCK_SECOND / 16)
+#endif
+
+/* Hop limit given to locally originated readings */
+#define FWD_MAX_HOPS         16
+
+typedef void (*fwd_queue_sent_fn)(uint16_t len);
+
+/* MAC outcome of a frame sent to `dest`: a MAC_TX_* status */
+typedef void (*fwd_queue_status_fn)(const linkaddr_t *dest, int status,
+                                    int transmissions);
+
+/* Ticks until `dest` can receive, 0 if it can now */
+typedef clock_time_t (*fwd_queue_gate_fn)(const linkaddr_t *dest);
+
+/* Next hop for one frame, the null address if there is none */
+typedef const linkaddr_t *(*fwd_queue_hop_fn)(void);
+
+/* A frame went to the MAC (1) or its MAC callback came (0) */
+typedef void (*fwd_queue_hold_fn)(int on);
+
+struct fwd_queue_stats {
+  uint32_t sent;        /* frames handed to the network layer */
+  uint32_t overflows;   /* frames dropped because the queue was full */
+  uint32_t requeued;    /* frames sent again for want of an ack */
+  uint32_t tx_drops;    /* frames dropped after FWD_QUEUE_TRIES */
+  uint32_t ttl_drops;   /* readings dropped at the hop limit */
+};
+extern struct fwd_queue_stats fwd_queue_stats;
+
+/* Frames go to *dest, read at send time; nothing leaves while it is null */
+void fwd_queue_init(const linkaddr_t *dest, fwd_queue_sent_fn sent);
+
+/* Hold frames back while gate() is non-zero; NULL sends right away */
+void fwd_queue_set_gate(fwd_queue_gate_fn gate);
+
+/* Pick the next hop per frame; NULL sends every frame to *dest */
+void fwd_queue_set_next_hop(fwd_queue_hop_fn hop);
+
+/* Report how every frame fared at the MAC layer */
+void fwd_queue_set_status(fwd_queue_status_fn status);
+
+/* Bracket every frame's time with the MAC, e.g. to keep the radio on */
+void fwd_queue_set_hold(fwd_queue_hold_fn hold);
+
+/* Copy a frame into the queue, returns 0 if it was too long or dropped */
+int  fwd_queue_push(const void *data, uint16_t len);
+
+/* The destination changed: choose again and try to drain now */
+void fwd_queue_kick(void);
+
+#endif /* FWD_QUEUE_H_ */
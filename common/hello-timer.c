@@ -0,0 +1,38 @@
+/* hello-timer.c */
+
+#include "hello-timer.h"
+#include "lib/trickle-timer.h"
+
+static struct trickle_timer hello_tt;
+static hello_send_fn        hello_send;
+
+/*---------------------------------------------------------------------------*/
+static void
+fire(void *ptr, uint8_t suppress)
+{
+  if(suppress == TRICKLE_TIMER_TX_SUPPRESS) {
+    return;
+  }
+  hello_send();
+}
+/*---------------------------------------------------------------------------*/
+void
+hello_timer_init(hello_send_fn send)
+{
+  hello_send = send;
+  trickle_timer_config(&hello_tt, HELLO_IMIN, HELLO_IMAX, HELLO_K);
+  trickle_timer_set(&hello_tt, fire, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+hello_timer_consistent(void)
+{
+  trickle_timer_consistency(&hello_tt);
+}
+/*---------------------------------------------------------------------------*/
+void
+hello_timer_reset(void)
+{
+  trickle_timer_reset_event(&hello_tt);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,44 @@
+/* hello-timer.h */
+
+#ifndef HELLO_TIMER_H_
+#define HELLO_TIMER_H_
+
+#include "contiki.h"
+
+/*
+ * Trickle schedule for rank beacons, for the firmwares without a tree
+ * module of their own (energised/tree.c runs the same one). The interval
+ * starts at HELLO_IMIN and doubles up to HELLO_IMAX times while the
+ * neighbourhood agrees; a beacon is left out once HELLO_K consistent
+ * ones were heard in its interval.
+ */
+#ifdef HELLO_CONF_IMIN
+#define HELLO_IMIN  HELLO_CONF_IMIN
+#else
+#define HELLO_IMIN  (CLOCK_SECOND * 4)
+#endif
+
+#ifdef HELLO_CONF_IMAX
+#define HELLO_IMAX  HELLO_CONF_IMAX
+#else
+#define HELLO_IMAX  8          /* 4 s << 8 = ~17 min */
+#endif
+
+#ifdef HELLO_CONF_K
+#define HELLO_K     HELLO_CONF_K
+#else
+#define HELLO_K     3
+#endif
+
+typedef void (*hello_send_fn)(void);
+
+/* Start beaconing; send() broadcasts the rank */
+void hello_timer_init(hello_send_fn send);
+
+/* A neighbour's beacon agreed with ours (nothing to do for either) */
+void hello_timer_consistent(void);
+
+/* Our rank or parent changed, or a neighbour needs one: beacon soon */
+void hello_timer_reset(void);
+
+#endif /* HELLO_TIMER_H_ */
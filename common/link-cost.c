@@ -0,0 +1,31 @@
+/* link-cost.c */
+
+#include "link-cost.h"
+#include "net/link-stats.h"
+
+/*---------------------------------------------------------------------------*/
+uint16_t
+link_cost(const linkaddr_t *nbr)
+{
+  const struct link_stats *stats = link_stats_from_lladdr(nbr);
+  uint32_t cost;
+
+  if(stats == NULL) {
+    return LINK_COST_UNKNOWN;
+  }
+  cost = stats->etx;
+  if(stats->rssi < LINK_COST_RSSI_WEAK) {
+    cost += (uint32_t)(LINK_COST_RSSI_WEAK - stats->rssi)
+            * LINK_COST_RSSI_WEIGHT;
+  }
+  return cost > 0xFFFF ? 0xFFFF : (uint16_t)cost;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+link_cost_rank(uint16_t rank, const linkaddr_t *nbr)
+{
+  uint32_t r = (uint32_t)rank + link_cost(nbr);
+
+  return r > 0xFFFF ? 0xFFFF : (uint16_t)r;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,48 @@
+/* link-cost.h */
+
+#ifndef LINK_COST_H_
+#define LINK_COST_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+/*
+ * Ranks are path costs: the root is 0 and every hop adds the cost of its
+ * link, LINK_COST_HOP for a perfect one. The link cost is the ETX kept by
+ * link-stats (seeded from RSSI before the first unicast) plus a penalty
+ * for links close to the sensitivity floor, which lose frames first.
+ * Under NullNet nothing feeds link-stats received frames: every role
+ * calls link_stats_input_callback() on its input.
+ */
+#define LINK_COST_HOP            128    /* LINK_STATS_ETX_DIVISOR */
+
+/* Cost of a neighbour link-stats has not seen yet: ETX 2 */
+#define LINK_COST_UNKNOWN        (2 * LINK_COST_HOP)
+
+/* Links weaker than this RSSI pay LINK_COST_RSSI_WEIGHT per dBm below */
+#ifdef LINK_COST_CONF_RSSI_WEAK
+#define LINK_COST_RSSI_WEAK      LINK_COST_CONF_RSSI_WEAK
+#else
+#define LINK_COST_RSSI_WEAK      (-85)
+#endif
+
+#define LINK_COST_RSSI_WEIGHT    8
+
+/* A new parent must be this much cheaper than the current one */
+#ifdef LINK_COST_CONF_HYSTERESIS
+#define LINK_COST_HYSTERESIS     LINK_COST_CONF_HYSTERESIS
+#else
+#define LINK_COST_HYSTERESIS     (LINK_COST_HOP / 2)
+#endif
+
+/* Cost of the link to a neighbour */
+uint16_t link_cost(const linkaddr_t *nbr);
+
+/* Our rank through a neighbour advertising `rank`, saturating at 0xFFFF */
+uint16_t link_cost_rank(uint16_t rank, const linkaddr_t *nbr);
+
+/* A candidate rank (or cost) beats the current one by the hysteresis */
+#define LINK_COST_BETTER(cand, cur) \
+  ((uint32_t)(cand) + LINK_COST_HYSTERESIS < (uint32_t)(cur))
+
+#endif /* LINK_COST_H_ */
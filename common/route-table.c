@@ -0,0 +1,70 @@
+/* route-table.c */
+
+#include "route-table.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+
+struct route {
+  struct route  *next;
+  unsigned long  last_ts;   /* clock_seconds() of last refresh */
+  linkaddr_t     nexthop;
+  uint8_t        dest;
+};
+
+MEMB(routes_memb, struct route, ROUTE_TABLE_SIZE);
+LIST(routes);
+
+/*---------------------------------------------------------------------------*/
+void
+route_table_init(void)
+{
+  memb_init(&routes_memb);
+  list_init(routes);
+}
+/*---------------------------------------------------------------------------*/
+static struct route *
+find(uint8_t dest)
+{
+  unsigned long now = clock_seconds();
+  struct route *r = list_head(routes);
+
+  while(r != NULL) {
+    struct route *next = list_item_next(r);
+    if(now - r->last_ts > ROUTE_TABLE_LIFETIME) {
+      list_remove(routes, r);
+      memb_free(&routes_memb, r);
+    } else if(r->dest == dest) {
+      return r;
+    }
+    r = next;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+route_learn(uint8_t dest, const linkaddr_t *nexthop)
+{
+  struct route *r = find(dest);
+
+  if(r != NULL) {
+    list_remove(routes, r);
+  } else {
+    r = memb_alloc(&routes_memb);
+    if(r == NULL) {
+      /* the list is kept most recent first: recycle the stalest */
+      r = list_chop(routes);
+    }
+    r->dest = dest;
+  }
+  linkaddr_copy(&r->nexthop, nexthop);
+  r->last_ts = clock_seconds();
+  list_push(routes, r);
+}
+/*---------------------------------------------------------------------------*/
+const linkaddr_t *
+route_lookup(uint8_t dest)
+{
+  struct route *r = find(dest);
+  return r != NULL ? &r->nexthop : NULL;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,34 @@
+/* route-table.h */
+
+#ifndef ROUTE_TABLE_H_
+#define ROUTE_TABLE_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+/* Descendants a node can route commands to */
+#ifdef ROUTE_TABLE_CONF_SIZE
+#define ROUTE_TABLE_SIZE      ROUTE_TABLE_CONF_SIZE
+#else
+#define ROUTE_TABLE_SIZE      32
+#endif
+
+/* Seconds a route lives without upstream traffic refreshing it */
+#ifdef ROUTE_TABLE_CONF_LIFETIME
+#define ROUTE_TABLE_LIFETIME  ROUTE_TABLE_CONF_LIFETIME
+#else
+#define ROUTE_TABLE_LIFETIME  (15 * 60)
+#endif
+
+/* Hop limit given to commands injected into the tree */
+#define ROUTE_MAX_HOPS        16
+
+void              route_table_init(void);
+
+/* Upstream traffic from `dest` reached us through `nexthop` */
+void              route_learn(uint8_t dest, const linkaddr_t *nexthop);
+
+/* Next hop towards `dest`, NULL if unknown or expired */
+const linkaddr_t *route_lookup(uint8_t dest);
+
+#endif /* ROUTE_TABLE_H_ */
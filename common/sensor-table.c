@@ -0,0 +1,100 @@
+/* sensor-table.c */
+
+#include "sensor-table.h"
+#include "lib/memb.h"
+#include <string.h>
+
+MEMB(windows_memb, sensor_window_t, SENSOR_TABLE_SIZE);
+
+static sensor_window_t *buckets[SENSOR_TABLE_BUCKETS];
+static sensor_window_t *lru_head, *lru_tail;
+
+struct sensor_table_stats sensor_table_stats;
+
+#define BUCKET(id)  (&buckets[(id) & (SENSOR_TABLE_BUCKETS - 1)])
+
+/*---------------------------------------------------------------------------*/
+static void
+lru_unlink(sensor_window_t *w)
+{
+  if(w->lru_prev) w->lru_prev->lru_next = w->lru_next;
+  else            lru_head = w->lru_next;
+  if(w->lru_next) w->lru_next->lru_prev = w->lru_prev;
+  else            lru_tail = w->lru_prev;
+}
+/*---------------------------------------------------------------------------*/
+static void
+lru_push_front(sensor_window_t *w)
+{
+  w->lru_prev = NULL;
+  w->lru_next = lru_head;
+  if(lru_head) lru_head->lru_prev = w;
+  else         lru_tail = w;
+  lru_head = w;
+}
+/*---------------------------------------------------------------------------*/
+static void
+release(sensor_window_t *w)
+{
+  sensor_window_t **pp = BUCKET(w->id);
+  while(*pp != w) {
+    pp = &(*pp)->hnext;
+  }
+  *pp = w->hnext;
+  lru_unlink(w);
+  memb_free(&windows_memb, w);
+}
+/*---------------------------------------------------------------------------*/
+void
+sensor_table_init(void)
+{
+  memb_init(&windows_memb);
+  memset(buckets, 0, sizeof(buckets));
+  lru_head = lru_tail = NULL;
+  memset(&sensor_table_stats, 0, sizeof(sensor_table_stats));
+}
+/*---------------------------------------------------------------------------*/
+sensor_window_t *
+sensor_table_get(uint8_t id)
+{
+  unsigned long now = clock_seconds();
+  sensor_window_t *w;
+
+  /* Expire stale windows; the LRU tail is always the oldest */
+  while(lru_tail && now - lru_tail->last_ts > SENSOR_TABLE_EXPIRY) {
+    release(lru_tail);
+    sensor_table_stats.expiries++;
+  }
+
+  /* Return existing window */
+  for(w = *BUCKET(id); w != NULL; w = w->hnext) {
+    if(w->id == id) {
+      sensor_table_stats.hits++;
+      lru_unlink(w);
+      lru_push_front(w);
+      w->last_ts = now;
+      return w;
+    }
+  }
+
+  /* Allocate, recycling the least recently used window if it is idle */
+  w = memb_alloc(&windows_memb);
+  if(w == NULL) {
+    if(lru_tail == NULL || now - lru_tail->last_ts < SENSOR_TABLE_EVICT_AGE) {
+      sensor_table_stats.drops++;
+      return NULL;
+    }
+    release(lru_tail);
+    sensor_table_stats.evictions++;
+    w = memb_alloc(&windows_memb);
+  }
+  w->id = id;
+  w->last_ts = now;
+  slope_window_init(&w->win);
+  w->hnext = *BUCKET(id);
+  *BUCKET(id) = w;
+  lru_push_front(w);
+  sensor_table_stats.inserts++;
+  return w;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,64 @@
+/* sensor-table.h */
+
+#ifndef SENSOR_TABLE_H_
+#define SENSOR_TABLE_H_
+
+#include "contiki.h"
+#include "slope-window.h"
+
+/* Number of sensor windows held by a computation node */
+#ifdef SENSOR_TABLE_CONF_SIZE
+#define SENSOR_TABLE_SIZE       SENSOR_TABLE_CONF_SIZE
+#else
+#define SENSOR_TABLE_SIZE       32
+#endif
+
+/* Hash buckets for the id index (power of two) */
+#ifdef SENSOR_TABLE_CONF_BUCKETS
+#define SENSOR_TABLE_BUCKETS    SENSOR_TABLE_CONF_BUCKETS
+#else
+#define SENSOR_TABLE_BUCKETS    16
+#endif
+
+/* Seconds without a reading before a window is discarded */
+#ifdef SENSOR_TABLE_CONF_EXPIRY
+#define SENSOR_TABLE_EXPIRY     SENSOR_TABLE_CONF_EXPIRY
+#else
+#define SENSOR_TABLE_EXPIRY     (5 * 60)
+#endif
+
+/* A window fed within this many seconds is never evicted for a newcomer */
+#ifdef SENSOR_TABLE_CONF_EVICT_AGE
+#define SENSOR_TABLE_EVICT_AGE  SENSOR_TABLE_CONF_EVICT_AGE
+#else
+#define SENSOR_TABLE_EVICT_AGE  120
+#endif
+
+#if (SENSOR_TABLE_BUCKETS & (SENSOR_TABLE_BUCKETS - 1)) != 0
+#error "SENSOR_TABLE_BUCKETS must be a power of two"
+#endif
+
+/* Per-sensor sliding window */
+typedef struct sensor_window {
+  struct sensor_window *lru_prev, *lru_next;  /* most recent first */
+  struct sensor_window *hnext;                /* hash chain */
+  unsigned long  last_ts;                     /* clock_seconds() of last use */
+  uint8_t        id;                          /* sensor address */
+  slope_window_t win;                         /* readings + running sums */
+} sensor_window_t;
+
+struct sensor_table_stats {
+  uint32_t hits;       /* lookups that found a live window */
+  uint32_t inserts;    /* new windows created */
+  uint32_t expiries;   /* windows dropped after SENSOR_TABLE_EXPIRY */
+  uint32_t evictions;  /* idle windows recycled for a new sensor */
+  uint32_t drops;      /* lookups refused: table full of active sensors */
+};
+extern struct sensor_table_stats sensor_table_stats;
+
+void             sensor_table_init(void);
+
+/* Find the window of `id`, creating it if needed. NULL if it was dropped. */
+sensor_window_t *sensor_table_get(uint8_t id);
+
+#endif /* SENSOR_TABLE_H_ */
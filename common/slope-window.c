@@ -0,0 +1,49 @@
+/* slope-window.c */
+
+#include "slope-window.h"
+#include <string.h>
+
+#define N        ((int64_t)SLOPE_WINDOW_SIZE)
+/* sum(k) and N*sum(k^2) - sum(k)^2 over k = 0..N-1 */
+#define SUM_I    (N * (N - 1) / 2)
+#define DEN      (N * N * (N * N - 1) / 12)
+
+/*---------------------------------------------------------------------------*/
+void
+slope_window_init(slope_window_t *w)
+{
+  memset(w, 0, sizeof(*w));
+}
+/*---------------------------------------------------------------------------*/
+void
+slope_window_push(slope_window_t *w, uint16_t v)
+{
+  if(w->count < SLOPE_WINDOW_SIZE) {
+    /* append at position count */
+    w->sum_iv += (uint32_t)w->count * v;
+    w->sum_v  += v;
+    w->count++;
+  } else {
+    /* drop the oldest (k=0), shift every other k down by one, append at N-1 */
+    uint16_t old = w->values[w->idx];
+    w->sum_v  -= old;
+    w->sum_iv -= w->sum_v;
+    w->sum_iv += (uint32_t)(SLOPE_WINDOW_SIZE - 1) * v;
+    w->sum_v  += v;
+  }
+  w->values[w->idx] = v;
+  if(++w->idx == SLOPE_WINDOW_SIZE) {
+    w->idx = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+int32_t
+slope_window_slope(const slope_window_t *w)
+{
+  if(!slope_window_full(w)) {
+    return 0;
+  }
+  int64_t num = N * (int64_t)w->sum_iv - SUM_I * (int64_t)w->sum_v;
+  return (int32_t)(num * SLOPE_SCALE / DEN);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,49 @@
+/* slope-window.h */
+
+#ifndef SLOPE_WINDOW_H_
+#define SLOPE_WINDOW_H_
+
+#include <stdint.h>
+
+/* Number of samples in the regression window (override at build time) */
+#ifdef SLOPE_WINDOW_CONF_SIZE
+#define SLOPE_WINDOW_SIZE  SLOPE_WINDOW_CONF_SIZE
+#else
+#define SLOPE_WINDOW_SIZE  30
+#endif
+
+/* Keeps sum_iv inside 32 bits for any 16-bit reading */
+#if SLOPE_WINDOW_SIZE < 2 || SLOPE_WINDOW_SIZE > 256
+#error "SLOPE_WINDOW_SIZE must be in [2, 256]"
+#endif
+
+/* Slopes are reported in thousandths of a value unit per sample */
+#define SLOPE_SCALE        1000
+
+/*
+ * Ring of the last SLOPE_WINDOW_SIZE readings plus the running sums
+ * sum_v = sum(v_k) and sum_iv = sum(k * v_k), k = 0 being the oldest.
+ * Both sums are updated in O(1) on every push.
+ */
+typedef struct {
+  uint16_t count;                        /* readings stored */
+  uint16_t idx;                          /* next write index (= oldest when full) */
+  uint32_t sum_v;
+  uint32_t sum_iv;
+  uint16_t values[SLOPE_WINDOW_SIZE];
+} slope_window_t;
+
+void    slope_window_init(slope_window_t *w);
+void    slope_window_push(slope_window_t *w, uint16_t v);
+#define slope_window_full(w)  ((w)->count >= SLOPE_WINDOW_SIZE)
+
+/* Least-squares slope of the full window times SLOPE_SCALE (0 if not full) */
+int32_t slope_window_slope(const slope_window_t *w);
+
+/* Print helpers for a scaled slope: printf("slope=" SLOPE_FMT, SLOPE_ARGS(s)) */
+#define SLOPE_FMT        "%s%lu.%02lu"
+#define SLOPE_ARGS(s)    ((s) < 0 ? "-" : ""),                          \
+    (unsigned long)(((s) < 0 ? -(s) : (s)) / SLOPE_SCALE),              \
+    (unsigned long)((((s) < 0 ? -(s) : (s)) % SLOPE_SCALE) / 10)
+
+#endif /* SLOPE_WINDOW_H_ */
@@ -0,0 +1,172 @@
+/* aggregate.c */
+
+#include "aggregate.h"
+#include "proto.h"
+#include "fwd-queue.h"
+#include "route-table.h"
+#include "slope-window.h"
+#include <string.h>
+
+/* One sensor's readings this epoch, k = 0 being the first */
+struct acc {
+  uint8_t  node;
+  uint8_t  count;
+  uint16_t min, max;
+  uint32_t sum_v;
+  uint32_t sum_iv;      /* sum(k * v_k) */
+};
+
+static struct acc     accs[AGGREGATE_SENSORS];
+static uint8_t        acc_count;
+static uint8_t        epoch;
+static struct ctimer  epoch_timer;
+static uint8_t        frame[SUMMARY_HDR_LEN
+                            + AGGREGATE_MAX_RECORDS * SUMMARY_RECORD_LEN];
+
+/*---------------------------------------------------------------------------*/
+/* Least-squares slope over k = 0..n-1, as slope_window_slope() */
+static int16_t
+acc_slope(const struct acc *a)
+{
+  int64_t n = a->count;
+  int64_t num, den, slope;
+
+  if(n < 2) {
+    return 0;
+  }
+  num = n * (int64_t)a->sum_iv - n * (n - 1) / 2 * (int64_t)a->sum_v;
+  den = n * n * (n * n - 1) / 12;
+  slope = num * SLOPE_SCALE / den;
+  return (int16_t)MAX(MIN(slope, INT16_MAX), INT16_MIN);
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_summary(uint8_t *rec, const struct aggregate_summary *s)
+{
+  rec[0] = s->node;
+  rec[1] = s->origin;
+  rec[2] = s->epoch;
+  rec[3] = s->count;
+  memcpy(&rec[4], &s->min, sizeof(s->min));
+  memcpy(&rec[6], &s->max, sizeof(s->max));
+  memcpy(&rec[8], &s->mean, sizeof(s->mean));
+  memcpy(&rec[10], &s->slope, sizeof(s->slope));
+}
+/*---------------------------------------------------------------------------*/
+/* End of epoch: send every summary up, as few frames as it takes */
+static void
+emit(void *ptr)
+{
+  uint8_t i, n = 0;
+
+  for(i = 0; i < acc_count; i++) {
+    const struct acc *a = &accs[i];
+    struct aggregate_summary s = {
+      a->node, linkaddr_node_addr.u8[0], epoch, a->count, a->min, a->max,
+      (uint16_t)((a->sum_v + a->count / 2) / a->count), acc_slope(a)
+    };
+    put_summary(&frame[SUMMARY_HDR_LEN + n * SUMMARY_RECORD_LEN], &s);
+    if(++n == AGGREGATE_MAX_RECORDS || i + 1 == acc_count) {
+      frame[0] = MSG_SUMMARY;
+      frame[1] = FWD_MAX_HOPS;
+      frame[2] = n;
+      fwd_queue_push(frame, SUMMARY_HDR_LEN + n * SUMMARY_RECORD_LEN);
+      n = 0;
+    }
+  }
+  acc_count = 0;
+  epoch++;
+}
+/*---------------------------------------------------------------------------*/
+void
+aggregate_init(void)
+{
+  acc_count = 0;
+  epoch = 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+aggregate_add(uint8_t node, uint16_t value)
+{
+  struct acc *a = NULL;
+  uint8_t i;
+
+  for(i = 0; i < acc_count; i++) {
+    if(accs[i].node == node) {
+      a = &accs[i];
+      break;
+    }
+  }
+  if(a == NULL) {
+    if(acc_count == AGGREGATE_SENSORS) {
+      return 0;
+    }
+    a = &accs[acc_count++];
+    memset(a, 0, sizeof(*a));
+    a->node = node;
+    a->min = value;
+    a->max = value;
+  }
+  if(a->count == UINT8_MAX) {
+    return 0;
+  }
+  a->sum_iv += (uint32_t)a->count * value;
+  a->sum_v += value;
+  a->count++;
+  a->min = MIN(a->min, value);
+  a->max = MAX(a->max, value);
+  if(ctimer_expired(&epoch_timer)) {
+    /* the epoch starts with its first reading */
+    ctimer_set(&epoch_timer, AGGREGATE_EPOCH, emit, NULL);
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+aggregate_input(const void *data, uint16_t len, const linkaddr_t *src,
+                aggregate_summary_fn fn)
+{
+  const uint8_t *buf = data;
+  const uint8_t *rec;
+  struct aggregate_summary s;
+  uint8_t i;
+
+  if(len < SUMMARY_HDR_LEN || buf[0] != MSG_SUMMARY
+     || len < SUMMARY_HDR_LEN + buf[2] * SUMMARY_RECORD_LEN) {
+    return 0;
+  }
+  rec = &buf[SUMMARY_HDR_LEN];
+  for(i = 0; i < buf[2]; i++, rec += SUMMARY_RECORD_LEN) {
+    route_learn(rec[0], src);
+    if(fn) {
+      s.node = rec[0];
+      s.origin = rec[1];
+      s.epoch = rec[2];
+      s.count = rec[3];
+      memcpy(&s.min, &rec[4], sizeof(s.min));
+      memcpy(&s.max, &rec[6], sizeof(s.max));
+      memcpy(&s.mean, &rec[8], sizeof(s.mean));
+      memcpy(&s.slope, &rec[10], sizeof(s.slope));
+      fn(&s);
+    }
+  }
+  return buf[2];
+}
+/*---------------------------------------------------------------------------*/
+void
+aggregate_relay(const void *data, uint16_t len)
+{
+  uint8_t copy[SUMMARY_HDR_LEN + AGGREGATE_MAX_RECORDS * SUMMARY_RECORD_LEN];
+
+  if(len > sizeof(copy)) {
+    return;
+  }
+  memcpy(copy, data, len);
+  if(copy[1] <= 1) {
+    fwd_queue_stats.ttl_drops++;
+    return;
+  }
+  copy[1]--;
+  fwd_queue_push(copy, len);
+}
+/*---------------------------------------------------------------------------*/
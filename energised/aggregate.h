@@ -0,0 +1,68 @@
+/* aggregate.h */
+
+#ifndef AGGREGATE_H_
+#define AGGREGATE_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+/*
+ * In-network aggregation. A computation node that would relay raw
+ * readings upstream (in DEEP_LPM) folds them instead into one summary
+ * per sensor and epoch: count, min, max, mean and the least-squares
+ * slope over the epoch. Summaries go up in MSG_SUMMARY frames, which
+ * other nodes relay as they are and the border router hands to the
+ * server.
+ */
+#ifdef AGGREGATE_CONF_ENABLED
+#define AGGREGATE_ENABLED      AGGREGATE_CONF_ENABLED
+#else
+#define AGGREGATE_ENABLED      1
+#endif
+
+#ifdef AGGREGATE_CONF_EPOCH
+#define AGGREGATE_EPOCH        AGGREGATE_CONF_EPOCH
+#else
+#define AGGREGATE_EPOCH        (CLOCK_SECOND * 300)
+#endif
+
+/* Sensors summarised per epoch; readings of any further one are relayed */
+#ifdef AGGREGATE_CONF_SENSORS
+#define AGGREGATE_SENSORS      AGGREGATE_CONF_SENSORS
+#else
+#define AGGREGATE_SENSORS      16
+#endif
+
+/* Summaries per MSG_SUMMARY frame, so one fits a forward-queue slot */
+#define AGGREGATE_MAX_RECORDS  6
+
+/* One summary, as carried on the air and to the server */
+struct aggregate_summary {
+  uint8_t  node;
+  uint8_t  origin;     /* the computation node that summarised */
+  uint8_t  epoch;      /* per origin; (origin, node, epoch) is unique */
+  uint8_t  count;
+  uint16_t min, max;
+  uint16_t mean;       /* rounded */
+  int16_t  slope;      /* per sample, times SLOPE_SCALE, saturated */
+};
+
+typedef void (*aggregate_summary_fn)(const struct aggregate_summary *s);
+
+void    aggregate_init(void);
+
+/* Fold a reading into its sensor's summary; 0 if there was no room */
+int     aggregate_add(uint8_t node, uint16_t value);
+
+/*
+ * Walk a MSG_SUMMARY frame received from `src` and pass each summary to
+ * fn. Every summarised sensor is learnt as reachable through `src`.
+ * Returns the number of summaries, 0 if the frame is not a summary frame.
+ */
+uint8_t aggregate_input(const void *data, uint16_t len, const linkaddr_t *src,
+                        aggregate_summary_fn fn);
+
+/* Relay a MSG_SUMMARY frame one hop up, unless its hop limit is spent */
+void    aggregate_relay(const void *data, uint16_t len);
+
+#endif /* AGGREGATE_H_ */
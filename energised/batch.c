@@ -0,0 +1,160 @@
+/* batch.c */
+
+#include "batch.h"
+#include "proto.h"
+#include "codec.h"
+#include "dedup.h"
+#include "fwd-queue.h"
+#include "route-table.h"
+#include <string.h>
+
+static uint8_t            frame[BATCH_HDR_LEN + BATCH_MAX_RECORDS * BATCH_RECORD_LEN];
+static uint8_t            pending;
+static uint8_t            frame_ttl;
+static struct ctimer      flush_timer;
+
+/*---------------------------------------------------------------------------*/
+static void
+flush_cb(void *ptr)
+{
+  batch_flush();
+}
+/*---------------------------------------------------------------------------*/
+void
+batch_init(void)
+{
+  pending = 0;
+  dedup_init();
+  route_table_init();
+}
+/*---------------------------------------------------------------------------*/
+void
+batch_add(uint8_t node, uint8_t seq, uint16_t value, uint8_t ttl,
+          const struct trace *t)
+{
+  uint8_t *rec = &frame[BATCH_HDR_LEN + pending * BATCH_RECORD_LEN];
+  rec[0] = node;
+  rec[1] = seq;
+  memcpy(&rec[2], &value, sizeof(value));
+  if(TRACE_ENABLED) {
+    struct trace next = { 0 };
+    if(t != NULL) {
+      next = *t;
+    }
+    next.hops++;
+    trace_put(&rec[4], &next);
+  }
+  /* the frame lives as long as its most travelled record */
+  if(pending == 0 || ttl < frame_ttl) {
+    frame_ttl = ttl;
+  }
+  if(pending++ == 0) {
+    ctimer_set(&flush_timer, BATCH_FLUSH_DELAY, flush_cb, NULL);
+  }
+  if(pending == BATCH_MAX_RECORDS) {
+    batch_flush();
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+batch_flush(void)
+{
+  ctimer_stop(&flush_timer);
+  if(pending == 0) {
+    return;
+  }
+  if(BATCH_PACK) {
+    uint8_t packed[FWD_QUEUE_FRAME_LEN];
+    uint16_t len = codec_encode(&frame[BATCH_HDR_LEN], pending, frame_ttl,
+                                packed, sizeof(packed));
+    if(len > 0) {
+      fwd_queue_push(packed, len);
+      pending = 0;
+      return;
+    }
+  }
+  frame[0] = MSG_BATCH;
+  frame[1] = frame_ttl;
+  frame[2] = pending;
+  fwd_queue_push(frame, BATCH_HDR_LEN + pending * BATCH_RECORD_LEN);
+  pending = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+batch_forward(uint8_t node, uint8_t seq, uint16_t value, uint8_t ttl,
+              const struct trace *t)
+{
+  if(ttl <= 1) {
+    fwd_queue_stats.ttl_drops++;
+    return;
+  }
+  batch_add(node, seq, value, ttl - 1, t);
+}
+/*---------------------------------------------------------------------------*/
+static void
+walk_records(const uint8_t *rec, uint8_t count, uint8_t ttl,
+             const linkaddr_t *src, batch_record_fn fn)
+{
+  uint16_t value;
+  struct trace t;
+
+  for(uint8_t i = 0; i < count; i++, rec += BATCH_RECORD_LEN) {
+    route_learn(rec[0], src);
+    if(dedup_check(rec[0], rec[1])) {
+      memcpy(&value, &rec[2], sizeof(value));
+      if(TRACE_ENABLED) {
+        trace_get(&rec[4], &t);
+      }
+      fn(rec[0], rec[1], value, ttl, TRACE_ENABLED ? &t : NULL);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+batch_input(const void *data, uint16_t len, const linkaddr_t *src,
+            batch_record_fn fn)
+{
+  const uint8_t *buf = data;
+  uint8_t copy[FWD_QUEUE_FRAME_LEN];
+  linkaddr_t from;
+  uint16_t value;
+
+  /*
+   * fn may send, and sending refills the packetbuf that data and src
+   * point into: walk copies of both
+   */
+  linkaddr_copy(&from, src);
+
+  if(len >= 4 && buf[0] == MSG_READING) {
+    /* single reading straight from its sensor; seq is absent in old frames */
+    memcpy(&value, &buf[2], sizeof(value));
+    route_learn(buf[1], &from);
+    if(len < READING_LEN || dedup_check(buf[1], buf[4])) {
+      fn(buf[1], len >= READING_LEN ? buf[4] : 0, value, FWD_MAX_HOPS, NULL);
+    }
+    return 1;
+  }
+
+  if(len >= BATCH_HDR_LEN && buf[0] == MSG_BATCH
+     && len >= BATCH_HDR_LEN + buf[2] * BATCH_RECORD_LEN) {
+    if(len > sizeof(copy)) {
+      return 0;
+    }
+    memcpy(copy, buf, len);
+    walk_records(&copy[BATCH_HDR_LEN], copy[2], copy[1], &from, fn);
+    return copy[2];
+  }
+
+  if(len >= CODEC_HDR_LEN && buf[0] == MSG_PACKED) {
+    uint8_t records[BATCH_MAX_RECORDS * BATCH_RECORD_LEN];
+    uint8_t ttl = buf[1];
+    int count = codec_decode(buf, len, records, BATCH_MAX_RECORDS);
+    if(count < 0) {
+      return 0;
+    }
+    walk_records(records, count, ttl, &from, fn);
+    return count;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,64 @@
+/* batch.h */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+#include "trace.h"
+
+/* Records carried by one MSG_BATCH frame */
+#ifdef BATCH_CONF_MAX_RECORDS
+#define BATCH_MAX_RECORDS  BATCH_CONF_MAX_RECORDS
+#elif TRACE_ENABLED
+#define BATCH_MAX_RECORDS  10   /* traced records still fit a queue slot */
+#else
+#define BATCH_MAX_RECORDS  16
+#endif
+
+/* Longest a pending reading waits before the batch is sent */
+#ifdef BATCH_CONF_FLUSH_DELAY
+#define BATCH_FLUSH_DELAY  BATCH_CONF_FLUSH_DELAY
+#else
+#define BATCH_FLUSH_DELAY  (CLOCK_SECOND * 5)
+#endif
+
+/* Send batches as MSG_PACKED whenever that is shorter */
+#if TRACE_ENABLED
+#define BATCH_PACK         0    /* the codec knows no trace fields */
+#elif defined(BATCH_CONF_PACK)
+#define BATCH_PACK         BATCH_CONF_PACK
+#else
+#define BATCH_PACK         1
+#endif
+
+/* t is NULL unless TRACE_ENABLED */
+typedef void (*batch_record_fn)(uint8_t node, uint8_t seq, uint16_t value,
+                                uint8_t ttl, const struct trace *t);
+
+void    batch_init(void);
+
+/*
+ * Queue one reading; flushes when full or BATCH_FLUSH_DELAY later. Its
+ * trace, if any, goes out one hop longer.
+ */
+void    batch_add(uint8_t node, uint8_t seq, uint16_t value, uint8_t ttl,
+                  const struct trace *t);
+
+/* Hand the pending records to the forward queue now */
+void    batch_flush(void);
+
+/* Relay a received reading one hop up, unless its hop limit is spent */
+void    batch_forward(uint8_t node, uint8_t seq, uint16_t value, uint8_t ttl,
+                      const struct trace *t);
+
+/*
+ * Walk a MSG_READING, MSG_BATCH or MSG_PACKED frame received from `src` and pass each
+ * record not seen before to fn. Every origin in the frame is learnt as
+ * reachable through `src`. Returns the number of records in the frame,
+ * 0 if the frame is not a reading frame.
+ */
+uint8_t batch_input(const void *data, uint16_t len, const linkaddr_t *src,
+                    batch_record_fn fn);
+
+#endif /* BATCH_H_ */
@@ -0,0 +1,187 @@
+/* codec.c */
+
+#include "codec.h"
+#include "proto.h"
+#include <string.h>
+
+#define REC(r, i)     (&(r)[(i) * BATCH_RECORD_LEN])
+
+/* Bit stream over a byte buffer, least significant bit first */
+struct bits {
+  uint8_t  *buf;
+  uint32_t  pos;
+};
+
+/*---------------------------------------------------------------------------*/
+static void
+put_bits(struct bits *b, uint32_t v, uint8_t n)
+{
+  for(; n > 0; n--, v >>= 1, b->pos++) {
+    if(v & 1) {
+      b->buf[b->pos >> 3] |= 1 << (b->pos & 7);
+    }
+  }
+}
+
+static uint32_t
+get_bits(struct bits *b, uint8_t n)
+{
+  uint32_t v = 0;
+  uint8_t i;
+
+  for(i = 0; i < n; i++, b->pos++) {
+    v |= (uint32_t)((b->buf[b->pos >> 3] >> (b->pos & 7)) & 1) << i;
+  }
+  return v;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+zigzag(int32_t d)
+{
+  return ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+}
+
+static int32_t
+unzigzag(uint32_t v)
+{
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static uint8_t
+width(uint32_t max)
+{
+  uint8_t n = 0;
+
+  for(; max != 0; max >>= 1) {
+    n++;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+value_of(const uint8_t *rec)
+{
+  uint16_t v;
+
+  memcpy(&v, &rec[2], sizeof(v));
+  return v;
+}
+
+/* Deltas of record i from record i - 1 */
+static void
+deltas(const uint8_t *records, uint8_t i, uint32_t *gap, uint32_t *seq,
+       uint32_t *value)
+{
+  const uint8_t *p = REC(records, i - 1), *r = REC(records, i);
+
+  *gap = r[0] - p[0];
+  *seq = zigzag((int8_t)(r[1] - p[1]));
+  *value = zigzag((int32_t)value_of(r) - value_of(p));
+}
+/*---------------------------------------------------------------------------*/
+static void
+sort_records(uint8_t *records, uint8_t count)
+{
+  uint8_t tmp[BATCH_RECORD_LEN];
+  uint8_t i, j;
+
+  /* insertion sort by (node, seq): frames hold a few records */
+  for(i = 1; i < count; i++) {
+    memcpy(tmp, REC(records, i), BATCH_RECORD_LEN);
+    for(j = i; j > 0 && (REC(records, j - 1)[0] > tmp[0]
+                         || (REC(records, j - 1)[0] == tmp[0]
+                             && REC(records, j - 1)[1] > tmp[1])); j--) {
+      memcpy(REC(records, j), REC(records, j - 1), BATCH_RECORD_LEN);
+    }
+    memcpy(REC(records, j), tmp, BATCH_RECORD_LEN);
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+codec_encode(uint8_t *records, uint8_t count, uint8_t ttl,
+             uint8_t *out, uint16_t max)
+{
+  uint32_t max_gap = 0, max_seq = 0, max_value = 0;
+  uint32_t gap, seq, value;
+  uint8_t wn, ws, wv, i;
+  uint16_t len;
+  struct bits b;
+
+  if(count == 0) {
+    return 0;
+  }
+  sort_records(records, count);
+  for(i = 1; i < count; i++) {
+    deltas(records, i, &gap, &seq, &value);
+    max_gap = MAX(max_gap, gap);
+    max_seq = MAX(max_seq, seq);
+    max_value = MAX(max_value, value);
+  }
+  wn = width(max_gap);
+  ws = width(max_seq);
+  wv = width(max_value);
+  len = CODEC_HDR_LEN
+        + (32 + (uint16_t)(count - 1) * (wn + ws + wv) + 7) / 8;
+  if(len >= BATCH_HDR_LEN + count * BATCH_RECORD_LEN || len > max) {
+    return 0;
+  }
+
+  memset(out, 0, len);
+  out[0] = MSG_PACKED;
+  out[1] = ttl;
+  out[2] = count;
+  out[3] = wn | ws << 4;
+  out[4] = wv;
+  b.buf = &out[CODEC_HDR_LEN];
+  b.pos = 0;
+  /* the keyframe */
+  put_bits(&b, records[0], 8);
+  put_bits(&b, records[1], 8);
+  put_bits(&b, value_of(records), 16);
+  for(i = 1; i < count; i++) {
+    deltas(records, i, &gap, &seq, &value);
+    put_bits(&b, gap, wn);
+    put_bits(&b, seq, ws);
+    put_bits(&b, value, wv);
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+int
+codec_decode(const uint8_t *frame, uint16_t len, uint8_t *records,
+             uint8_t max)
+{
+  uint8_t count, wn, ws, wv, i;
+  uint16_t v;
+  struct bits b;
+
+  if(len < CODEC_HDR_LEN || frame[0] != MSG_PACKED) {
+    return -1;
+  }
+  count = frame[2];
+  wn = frame[3] & 0x0F;
+  ws = frame[3] >> 4;
+  wv = frame[4];
+  if(count == 0 || count > max || wn > 8 || ws > 8 || wv > 17
+     || 32 + (uint32_t)(count - 1) * (wn + ws + wv)
+        > (uint32_t)(len - CODEC_HDR_LEN) * 8) {
+    return -1;
+  }
+
+  b.buf = (uint8_t *)&frame[CODEC_HDR_LEN];
+  b.pos = 0;
+  records[0] = get_bits(&b, 8);
+  records[1] = get_bits(&b, 8);
+  v = get_bits(&b, 16);
+  memcpy(&records[2], &v, sizeof(v));
+  for(i = 1; i < count; i++) {
+    const uint8_t *p = REC(records, i - 1);
+    uint8_t *r = REC(records, i);
+    r[0] = p[0] + get_bits(&b, wn);
+    r[1] = p[1] + unzigzag(get_bits(&b, ws));
+    v = value_of(p) + unzigzag(get_bits(&b, wv));
+    memcpy(&r[2], &v, sizeof(v));
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
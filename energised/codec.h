@@ -0,0 +1,39 @@
+/* codec.h */
+
+#ifndef CODEC_H_
+#define CODEC_H_
+
+#include "contiki.h"
+
+/*
+ * Compact form of a run of batch records (node, seq, value LE), sent as
+ * MSG_PACKED. Records are sorted by node and seq; the first is stored
+ * whole as the frame's keyframe, every other one as the node gap, the
+ * zig-zag seq delta and the zig-zag value delta from the record before
+ * it, each field bit-packed at the narrowest width that fits the frame:
+ *
+ *   type, ttl, count, node_w | seq_w << 4, value_w, bits...
+ *
+ * Each frame is self-contained: relays re-batch and may pick another
+ * next hop per frame, so there is no state across frames to lose.
+ */
+
+/* Fixed part of a MSG_PACKED frame */
+#define CODEC_HDR_LEN  5
+
+/*
+ * Encode `count` records into out (at most `max` bytes) and return the
+ * frame length, or 0 if it would not be shorter than the plain batch.
+ * The records are sorted in place.
+ */
+uint16_t codec_encode(uint8_t *records, uint8_t count, uint8_t ttl,
+                      uint8_t *out, uint16_t max);
+
+/*
+ * Decode a MSG_PACKED frame into records (room for `max`) and return
+ * their number, or -1 if the frame is malformed.
+ */
+int      codec_decode(const uint8_t *frame, uint16_t len, uint8_t *records,
+                      uint8_t max);
+
+#endif /* CODEC_H_ */
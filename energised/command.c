@@ -0,0 +1,352 @@
+/* command.c */
+
+#include "command.h"
+#include "proto.h"
+#include "route-table.h"
+#include "lib/random.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include <string.h>
+
+/* A command we issued and still wait an ack for */
+struct pending {
+  uint8_t        node;        /* 0: free */
+  uint8_t        seq;
+  uint8_t        tries;
+  uint16_t       code;
+  clock_time_t   first;
+  struct trace   trace;
+  struct ctimer  timer;
+};
+
+/* A command or ack waiting for its next hop to listen */
+struct held {
+  linkaddr_t     to;
+  uint8_t        len;         /* 0: free */
+  uint8_t        buf[COMMAND_LEN];
+  struct ctimer  timer;
+};
+
+/* Last command a target took from one issuer */
+struct seen {
+  uint8_t  origin;            /* 0: free */
+  uint8_t  seq;
+};
+
+struct command_stats command_stats;
+
+static struct pending   pending[COMMAND_PENDING];
+static struct held      outbox[COMMAND_OUTBOX];
+static struct seen      seen[COMMAND_ORIGINS];
+static uint8_t          seen_next;
+static uint8_t          next_seq;
+static command_done_fn  done_fn;
+static command_gate_fn  gate_fn;
+static command_hold_fn  hold_fn;
+
+/*---------------------------------------------------------------------------*/
+static const linkaddr_t *
+next_hop(uint8_t node)
+{
+  static linkaddr_t direct;
+  const linkaddr_t *nexthop = route_lookup(node);
+
+  if(nexthop == NULL) {
+    /* never heard from it: assume it is a neighbour */
+    memset(&direct, 0, sizeof(direct));
+    direct.u8[0] = node;
+    nexthop = &direct;
+  }
+  return nexthop;
+}
+/*---------------------------------------------------------------------------*/
+static void
+mac_sent(void *ptr, int status, int transmissions)
+{
+  if(hold_fn) {
+    hold_fn(0);
+  }
+}
+
+/* What nullnet does, but keeping the MAC callback */
+static void
+transmit(const uint8_t *buf, uint8_t len, const linkaddr_t *to)
+{
+  packetbuf_clear();
+  packetbuf_copyfrom(buf, len);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, to);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
+  if(hold_fn) {
+    hold_fn(1);
+  }
+  NETSTACK_MAC.send(mac_sent, NULL);
+}
+
+static void
+release(void *ptr)
+{
+  struct held *h = ptr;
+
+  transmit(h->buf, h->len, &h->to);
+  h->len = 0;
+}
+
+/*
+ * Send now if `to` listens, else hold the frame until it does. Returns
+ * how long it is held, 0 if it went out now.
+ */
+static clock_time_t
+send_frame(const uint8_t *buf, uint8_t len, const linkaddr_t *to)
+{
+  clock_time_t wait = gate_fn ? gate_fn(to) : 0;
+  uint8_t i;
+
+  for(i = 0; wait > 0 && i < COMMAND_OUTBOX; i++) {
+    struct held *h = &outbox[i];
+    if(h->len == 0) {
+      linkaddr_copy(&h->to, to);
+      memcpy(h->buf, buf, len);
+      h->len = len;
+      ctimer_set(&h->timer, wait, release, h);
+      return wait;
+    }
+  }
+  transmit(buf, len, to);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns how long the copy waits for its next hop, see send_frame() */
+static clock_time_t
+output(uint8_t node, uint16_t code, uint8_t ttl, uint8_t origin, uint8_t seq,
+       const struct trace *t)
+{
+  uint8_t cmd[COMMAND_LEN] = { MSG_COMMAND, node };
+
+  memcpy(&cmd[2], &code, sizeof(code));
+  cmd[4] = ttl;
+  cmd[5] = origin;
+  cmd[6] = seq;
+  if(TRACE_ENABLED) {
+    struct trace next = *t;
+    next.hops++;
+    trace_put(&cmd[7], &next);
+  }
+  return send_frame(cmd, sizeof(cmd), next_hop(node));
+}
+
+static void
+output_ack(uint8_t origin, uint8_t node, uint8_t seq, uint8_t ttl)
+{
+  uint8_t ack[ACK_LEN] = { MSG_ACK, origin, node, seq, ttl };
+
+  send_frame(ack, sizeof(ack), next_hop(origin));
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+elapsed_ms(const struct pending *p)
+{
+  return (uint32_t)(clock_time() - p->first) * 1000 / CLOCK_SECOND;
+}
+
+static void
+finish(struct pending *p, uint32_t ms)
+{
+  uint8_t node = p->node;
+
+  ctimer_stop(&p->timer);
+  p->node = 0;
+  if(done_fn) {
+    done_fn(node, p->code, p->tries, ms);
+  }
+}
+
+/*
+ * Doubling delay plus up to one more base delay of jitter: a copy lost
+ * to a sleeping hop whose window is unknown is retried at another phase.
+ * It counts from when the copy goes out, `held` after it was queued.
+ */
+static clock_time_t
+retry_delay(uint8_t tries, clock_time_t held)
+{
+  clock_time_t delay = COMMAND_RETRY_DELAY << (tries - 1);
+
+  return held + delay + random_rand() % (COMMAND_RETRY_DELAY + 1);
+}
+
+static void
+retry(void *ptr)
+{
+  struct pending *p = ptr;
+  clock_time_t held;
+
+  if(p->tries >= COMMAND_MAX_TRIES) {
+    command_stats.failed++;
+    finish(p, 0);
+    return;
+  }
+  p->tries++;
+  command_stats.retries++;
+  held = output(p->node, p->code, ROUTE_MAX_HOPS, linkaddr_node_addr.u8[0],
+                p->seq, &p->trace);
+  ctimer_set(&p->timer, retry_delay(p->tries, held), retry, p);
+}
+/*---------------------------------------------------------------------------*/
+void
+command_init(command_done_fn done)
+{
+  done_fn = done;
+  memset(pending, 0, sizeof(pending));
+  next_seq = random_rand();
+}
+/*---------------------------------------------------------------------------*/
+void
+command_set_gate(command_gate_fn gate)
+{
+  gate_fn = gate;
+}
+/*---------------------------------------------------------------------------*/
+void
+command_set_hold(command_hold_fn hold)
+{
+  hold_fn = hold;
+}
+/*---------------------------------------------------------------------------*/
+const linkaddr_t *
+command_send(uint8_t node, uint16_t code, const struct trace *cause)
+{
+  struct pending *p = NULL, *oldest = &pending[0];
+  clock_time_t held;
+  uint8_t i;
+
+  for(i = 0; i < COMMAND_PENDING; i++) {
+    if(pending[i].node == node) {
+      if(pending[i].code == code) {
+        return next_hop(node);
+      }
+      /* superseded: the target only cares for the newest */
+      ctimer_stop(&pending[i].timer);
+      p = &pending[i];
+      break;
+    }
+    if(p == NULL && pending[i].node == 0) {
+      p = &pending[i];
+    }
+    if(pending[i].first < oldest->first) {
+      oldest = &pending[i];
+    }
+  }
+  if(p == NULL) {
+    command_stats.failed++;
+    finish(oldest, 0);
+    p = oldest;
+  }
+
+  p->node = node;
+  p->code = code;
+  p->seq = next_seq++;
+  p->tries = 1;
+  p->first = clock_time();
+  if(cause != NULL) {
+    p->trace = *cause;
+  } else {
+    trace_start(&p->trace, 0);
+  }
+  /* hops count the way down only */
+  p->trace.hops = 0;
+  command_stats.sent++;
+  held = output(node, code, ROUTE_MAX_HOPS, linkaddr_node_addr.u8[0], p->seq,
+                &p->trace);
+  ctimer_set(&p->timer, retry_delay(p->tries, held), retry, p);
+  return next_hop(node);
+}
+/*---------------------------------------------------------------------------*/
+/* Whether (origin, seq) is the command last taken from origin; records it */
+static int
+seen_before(uint8_t origin, uint8_t seq)
+{
+  uint8_t i;
+
+  for(i = 0; i < COMMAND_ORIGINS; i++) {
+    if(seen[i].origin == origin) {
+      if(seen[i].seq == seq) {
+        return 1;
+      }
+      seen[i].seq = seq;
+      return 0;
+    }
+  }
+  /* round robin: issuers are few and long-lived */
+  seen[seen_next].origin = origin;
+  seen[seen_next].seq = seq;
+  seen_next = (seen_next + 1) % COMMAND_ORIGINS;
+  return 0;
+}
+
+static int
+ack_input(const uint8_t *buf)
+{
+  uint8_t i;
+  uint32_t ms;
+
+  if(buf[1] != linkaddr_node_addr.u8[0]) {
+    if(buf[4] <= 1) {
+      return COMMAND_DROPPED;
+    }
+    output_ack(buf[1], buf[2], buf[3], buf[4] - 1);
+    return COMMAND_RELAYED;
+  }
+  for(i = 0; i < COMMAND_PENDING; i++) {
+    if(pending[i].node == buf[2] && pending[i].seq == buf[3]) {
+      ms = elapsed_ms(&pending[i]);
+      command_stats.acked++;
+      command_stats.latency_max = MAX(command_stats.latency_max, ms);
+      /* an instant ack still reads as acked */
+      finish(&pending[i], MAX(ms, 1));
+      break;
+    }
+  }
+  /* otherwise a late copy for a command already acked or given up */
+  return COMMAND_ACKED;
+}
+/*---------------------------------------------------------------------------*/
+int
+command_input(const void *data, uint16_t len, const linkaddr_t *src,
+              command_deliver_fn deliver)
+{
+  const uint8_t *buf = data;
+  uint16_t code;
+  struct trace t = { 0 };
+
+  if(len == ACK_LEN && buf[0] == MSG_ACK) {
+    return ack_input(buf);
+  }
+  if(len != COMMAND_LEN || buf[0] != MSG_COMMAND) {
+    return COMMAND_NONE;
+  }
+  /* the way back for its ack */
+  route_learn(buf[5], src);
+  memcpy(&code, &buf[2], sizeof(code));
+  if(TRACE_ENABLED) {
+    trace_get(&buf[7], &t);
+  }
+  if(buf[1] == linkaddr_node_addr.u8[0]) {
+    if(seen_before(buf[5], buf[6])) {
+      command_stats.duplicates++;
+    } else {
+      if(TRACE_ENABLED) {
+        trace_log("act", buf[5], buf[6], &t);
+      }
+      if(deliver) {
+        deliver(code);
+      }
+    }
+    output_ack(buf[5], buf[1], buf[6], ROUTE_MAX_HOPS);
+    return COMMAND_FOR_US;
+  }
+  if(buf[4] <= 1) {
+    return COMMAND_DROPPED;
+  }
+  output(buf[1], code, buf[4] - 1, buf[5], buf[6], &t);
+  return COMMAND_RELAYED;
+}
+/*---------------------------------------------------------------------------*/
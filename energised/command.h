@@ -0,0 +1,112 @@
+/* command.h */
+
+#ifndef COMMAND_H_
+#define COMMAND_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+#include "trace.h"
+
+/*
+ * Commands go down the tree along the routes learnt from readings and
+ * carry the issuer's id and a per-issuer sequence number. The target
+ * acks every copy it gets, fresh or not, and the ack goes back up along
+ * the routes the command itself taught the relays. The issuer keeps each
+ * command until it is acked and resends it with a doubling delay, so a
+ * lost OPEN_VALVE costs seconds rather than the next slope trigger.
+ * Both wait in a small outbox for the next hop's listen window.
+ */
+
+/* Commands awaiting an ack at once; a full table fails the oldest */
+#ifdef COMMAND_CONF_PENDING
+#define COMMAND_PENDING      COMMAND_CONF_PENDING
+#else
+#define COMMAND_PENDING      4
+#endif
+
+/* Delay from a copy going out to its retransmission, doubled each time */
+#ifdef COMMAND_CONF_RETRY_DELAY
+#define COMMAND_RETRY_DELAY  COMMAND_CONF_RETRY_DELAY
+#else
+#define COMMAND_RETRY_DELAY  (CLOCK_SECOND * 2)
+#endif
+
+/* Transmissions before a command is given up; bounds its latency */
+#ifdef COMMAND_CONF_MAX_TRIES
+#define COMMAND_MAX_TRIES    COMMAND_CONF_MAX_TRIES
+#else
+#define COMMAND_MAX_TRIES    5
+#endif
+
+/* Frames held back for a next hop's window; a full outbox sends at once */
+#ifdef COMMAND_CONF_OUTBOX
+#define COMMAND_OUTBOX       COMMAND_CONF_OUTBOX
+#else
+#define COMMAND_OUTBOX       4
+#endif
+
+/* Issuers whose last sequence number a target remembers */
+#ifdef COMMAND_CONF_ORIGINS
+#define COMMAND_ORIGINS      COMMAND_CONF_ORIGINS
+#else
+#define COMMAND_ORIGINS      4
+#endif
+
+enum {
+  COMMAND_NONE,       /* not a command or ack frame */
+  COMMAND_FOR_US,     /* delivered locally, or a duplicate re-acked */
+  COMMAND_RELAYED,    /* command or ack sent one hop further */
+  COMMAND_DROPPED,    /* hop limit reached */
+  COMMAND_ACKED,      /* an ack for one of our commands */
+};
+
+struct command_stats {
+  uint32_t sent;          /* commands issued */
+  uint32_t retries;       /* retransmissions */
+  uint32_t acked;
+  uint32_t failed;        /* out of tries, or evicted from a full table */
+  uint32_t duplicates;    /* copies received again and only re-acked */
+  uint32_t latency_max;   /* ms from first send to ack */
+};
+extern struct command_stats command_stats;
+
+typedef void (*command_deliver_fn)(uint16_t code);
+
+/* Ticks until `dest` can hear a frame, as fwd_queue_gate_fn */
+typedef clock_time_t (*command_gate_fn)(const linkaddr_t *dest);
+
+/* A frame went to the MAC (1) or its MAC callback came (0) */
+typedef void (*command_hold_fn)(int on);
+
+/* Outcome of one issued command: acked after `ms`, or failed (ms == 0) */
+typedef void (*command_done_fn)(uint8_t node, uint16_t code, uint8_t tries,
+                                uint32_t ms);
+
+/* Issuers only; `done` may be NULL */
+void              command_init(command_done_fn done);
+
+/* Hold commands and acks back while gate() is non-zero; NULL sends at once */
+void              command_set_gate(command_gate_fn gate);
+
+/* Bracket every frame's time with the MAC, as fwd_queue_set_hold() */
+void              command_set_hold(command_hold_fn hold);
+
+/*
+ * Send a command down the tree to `node` and retry it until acked,
+ * returns the next hop used. The same command already pending for the
+ * node is left to its retries; another one replaces it. `cause` is the
+ * trace of the reading that prompted it, NULL to start one here.
+ */
+const linkaddr_t *command_send(uint8_t node, uint16_t code,
+                               const struct trace *cause);
+
+/*
+ * Handle a MSG_COMMAND or MSG_ACK frame received from `src`: deliver the
+ * command here (`deliver` runs once per command, and may be NULL), take
+ * an ack for us, or relay either one hop on.
+ */
+int               command_input(const void *data, uint16_t len,
+                                const linkaddr_t *src,
+                                command_deliver_fn deliver);
+
+#endif /* COMMAND_H_ */
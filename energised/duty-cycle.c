@@ -0,0 +1,146 @@
+/* duty-cycle.c */
+
+#include "duty-cycle.h"
+#include "energy.h"
+#include "tree.h"
+#include "net/netstack.h"
+
+static clock_time_t  anchor;          /* start of our first window */
+static clock_time_t  period;          /* 0: radio always on */
+static struct ctimer cycle_timer;
+static uint8_t       in_flight;       /* unicasts awaiting their ack */
+
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+state_period(uint8_t state)
+{
+  switch(state) {
+  case POWER_LPM:
+    return DUTY_CYCLE_LPM_PERIOD;
+  case POWER_DEEP_LPM:
+    return DUTY_CYCLE_DEEP_PERIOD;
+  default:
+    return 0;
+  }
+}
+/*
+ * Where our windows are counted from. Every node, ACTIVE ones too, keeps
+ * its HELLOs to a grid of DUTY_CYCLE_LPM_PERIOD steps from this base, and
+ * a child takes its parent's, which its HELLOs carry as a phase into a
+ * DUTY_CYCLE_DEEP_PERIOD cycle (the periods divide each other). So parent
+ * and child listen together in LPM and in DEEP_LPM: the parent hears our
+ * HELLOs and knows when a command can come down to us. The root's grid is
+ * fixed at boot and does not move with its power state.
+ */
+static clock_time_t
+window_base(void)
+{
+  if(tree_rank != RANK_INFINITE
+     && !linkaddr_cmp(&tree_parent, &linkaddr_null)) {
+    return tree_parent_heard;
+  }
+  return anchor;
+}
+/*---------------------------------------------------------------------------*/
+/* Radio on for the window, off for the rest of the period */
+static void
+cycle(void *ptr)
+{
+  clock_time_t phase = (clock_time_t)(clock_time() - window_base()) % period;
+
+  if(tree_rank == RANK_INFINITE) {
+    /* an orphan listens until a neighbour's HELLO adopts it */
+    NETSTACK_RADIO.on();
+    ctimer_set(&cycle_timer, DUTY_CYCLE_WINDOW, cycle, NULL);
+  } else if(phase < DUTY_CYCLE_WINDOW) {
+    NETSTACK_RADIO.on();
+    ctimer_set(&cycle_timer, DUTY_CYCLE_WINDOW - phase, cycle, NULL);
+  } else {
+    if(in_flight == 0) {
+      NETSTACK_RADIO.off();
+    }
+    ctimer_set(&cycle_timer, period - phase, cycle, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+duty_cycle_init(void)
+{
+  anchor = clock_time();
+  period = 0;
+  in_flight = 0;
+  NETSTACK_RADIO.on();
+}
+/*---------------------------------------------------------------------------*/
+void
+duty_cycle_update(void)
+{
+  if(!DUTY_CYCLE_ENABLED) {
+    return;
+  }
+  period = state_period(energy_state());
+  if(period == 0) {
+    ctimer_stop(&cycle_timer);
+    NETSTACK_RADIO.on();
+    return;
+  }
+  cycle(NULL);
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t
+duty_cycle_next_window(void)
+{
+  /* ACTIVE: the grid an LPM child lines its windows up with */
+  clock_time_t p = period != 0 ? period : DUTY_CYCLE_LPM_PERIOD;
+  clock_time_t phase;
+
+  if(!DUTY_CYCLE_ENABLED) {
+    return 0;
+  }
+  if(tree_children_state() == POWER_DEEP_LPM) {
+    /* it would hear one of our HELLOs in four, and drop us for it */
+    p = DUTY_CYCLE_DEEP_PERIOD;
+  }
+  phase = (clock_time_t)(clock_time() - window_base()) % p;
+  return phase == 0 ? 0 : p - phase;
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t
+duty_cycle_phase(void)
+{
+  return (clock_time_t)(clock_time() - window_base()) % DUTY_CYCLE_DEEP_PERIOD;
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t
+duty_cycle_hop_wait(const linkaddr_t *dest)
+{
+  uint8_t state;
+  clock_time_t heard, p, phase;
+
+  if(!DUTY_CYCLE_ENABLED || !tree_neighbour(dest, &state, &heard)) {
+    return 0;
+  }
+  p = state_period(state);
+  if(p == 0) {
+    return 0;
+  }
+  /* a window opens every p from where its cycle began */
+  phase = (clock_time_t)(clock_time() - heard) % p;
+  if(phase < DUTY_CYCLE_WINDOW - DUTY_CYCLE_GUARD) {
+    return 0;
+  }
+  return p - phase;
+}
+/*---------------------------------------------------------------------------*/
+void
+duty_cycle_hold(int on)
+{
+  if(on) {
+    in_flight++;
+    NETSTACK_RADIO.on();
+  } else if(in_flight > 0 && --in_flight == 0 && period != 0) {
+    /* back to the schedule: off unless in a window */
+    cycle(NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,71 @@
+/* duty-cycle.h */
+
+#ifndef DUTY_CYCLE_H_
+#define DUTY_CYCLE_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+/*
+ * Radio duty cycling bound to the energy module's power states. ACTIVE
+ * keeps the radio on. LPM and DEEP_LPM switch it off except for a listen
+ * window at the start of every period. HELLOs are held back to the start
+ * of a window (for ACTIVE nodes, to where an LPM window would start) and
+ * say how far into the sender's window cycle they are, so a child that
+ * hears its parent's (or a backup's) HELLO knows when that neighbour
+ * listens and sends upstream frames only then. A node without
+ * a parent keeps listening so that tree repair does not wait on windows.
+ * A node's windows line up with its parent's, so commands can come down
+ * the tree too.
+ */
+#ifdef DUTY_CYCLE_CONF_ENABLED
+#define DUTY_CYCLE_ENABLED       DUTY_CYCLE_CONF_ENABLED
+#else
+#define DUTY_CYCLE_ENABLED       1
+#endif
+
+/* Listen window opened every period */
+#ifdef DUTY_CYCLE_CONF_WINDOW
+#define DUTY_CYCLE_WINDOW        DUTY_CYCLE_CONF_WINDOW
+#else
+#define DUTY_CYCLE_WINDOW        (CLOCK_SECOND / 2)
+#endif
+
+#ifdef DUTY_CYCLE_CONF_LPM_PERIOD
+#define DUTY_CYCLE_LPM_PERIOD    DUTY_CYCLE_CONF_LPM_PERIOD
+#else
+#define DUTY_CYCLE_LPM_PERIOD    (CLOCK_SECOND * 4)     /* 12.5 % on */
+#endif
+
+#ifdef DUTY_CYCLE_CONF_DEEP_PERIOD
+#define DUTY_CYCLE_DEEP_PERIOD   DUTY_CYCLE_CONF_DEEP_PERIOD
+#else
+#define DUTY_CYCLE_DEEP_PERIOD   (CLOCK_SECOND * 16)    /* ~3 % on */
+#endif
+
+/* Part of a parent's window left unused, for CSMA backoff and clock skew */
+#define DUTY_CYCLE_GUARD         (CLOCK_SECOND / 8)
+
+void         duty_cycle_init(void);
+
+/* The power state changed: restart the schedule from now */
+void         duty_cycle_update(void);
+
+/* Ticks until our next window starts; while ACTIVE, until the next step
+   of the LPM grid, so our HELLOs stay on it. With a child in DEEP_LPM,
+   until the next of its windows. */
+clock_time_t duty_cycle_next_window(void);
+
+/* Ticks since our current DUTY_CYCLE_DEEP_PERIOD cycle began, for HELLOs */
+clock_time_t duty_cycle_phase(void);
+
+/* Ticks until the neighbour `dest` listens, 0 if it does or is unknown */
+clock_time_t duty_cycle_hop_wait(const linkaddr_t *dest);
+
+/*
+ * A unicast went to the MAC (1) or its MAC callback came (0). The radio
+ * stays on while any is in flight, so its ack is heard outside a window.
+ */
+void         duty_cycle_hold(int on);
+
+#endif /* DUTY_CYCLE_H_ */
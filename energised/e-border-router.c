@@ -1,99 +1,122 @@
 /* e-border-router.c */
 
 #include "contiki.h"
-#include "energest.h"
 #include "dev/serial-line.h"
-#include "lib/random.h"
 #include "net/netstack.h"
 #include "net/nullnet/nullnet.h"
 #include "net/linkaddr.h"
+#include "net/link-stats.h"
+#include "batch.h"
+#include "aggregate.h"
+#include "telemetry.h"
+#include "proto.h"
+#include "tree.h"
+#include "command.h"
+#include "serial-proto.h"
+#include "energy.h"
+#include "duty-cycle.h"
+#include "evlog.h"
 #include <stdio.h>
 #include <string.h>
 
-#define HELLO_INTERVAL    (CLOCK_SECOND * 10)
-
-#ifndef BORDER_NODE_ID
-#define BORDER_NODE_ID    1
-#endif
-
-/* Battery model */
-#define BATTERY_MAX        100.0f
-#define LPM_THRESHOLD      30.0f
-#define DEEP_LPM_THRESHOLD 10.0f
-#define WAKE_THRESHOLD     90.0f
-#define CPU_COST           0.2f
-#define LPM_COST           0.02f
-#define TX_COST            1.0f
-#define RX_COST            1.0f
-#define COST_HELLO         1.0f
-#define COST_FORWARD       1.0f
-
-typedef struct {
-  uint8_t type, node;
-  uint16_t value;
-} packet_t;
-
-static uint16_t   my_rank;
-static struct etimer hello_timer, energy_timer;
-static float      battery_level = BATTERY_MAX;
-static enum { STATE_ACTIVE, STATE_LPM, STATE_DEEP_LPM } power_state = STATE_ACTIVE;
-static uint32_t   last_cpu, last_lpm, last_tx, last_rx;
-
 PROCESS(border_router_process, "E-Border router");
 AUTOSTART_PROCESSES(&border_router_process);
 
-/* Update battery from energest deltas */
+/* What our HELLOs advertise */
+static uint8_t
+tree_state(void)
+{
+  return energy_state();
+}
+
 static void
-update_battery(void)
+tree_hello_sent(void)
 {
-  energest_flush();
-  uint32_t d_cpu = energest_type_time(ENERGEST_TYPE_CPU)      - last_cpu;
-  uint32_t d_lpm = energest_type_time(ENERGEST_TYPE_LPM)      - last_lpm;
-  uint32_t d_tx  = energest_type_time(ENERGEST_TYPE_TRANSMIT) - last_tx;
-  uint32_t d_rx  = energest_type_time(ENERGEST_TYPE_LISTEN)   - last_rx;
-  last_cpu = energest_type_time(ENERGEST_TYPE_CPU);
-  last_lpm = energest_type_time(ENERGEST_TYPE_LPM);
-  last_tx  = energest_type_time(ENERGEST_TYPE_TRANSMIT);
-  last_rx  = energest_type_time(ENERGEST_TYPE_LISTEN);
-  float s_cpu = d_cpu / (float)CLOCK_SECOND;
-  float s_lpm = d_lpm / (float)CLOCK_SECOND;
-  float s_tx  = d_tx  / (float)CLOCK_SECOND;
-  float s_rx  = d_rx  / (float)CLOCK_SECOND;
-  battery_level -= s_cpu*CPU_COST + s_lpm*LPM_COST
-                 + s_tx*TX_COST  + s_rx*RX_COST;
+  energy_charge(ENERGY_HELLO);
 }
 
-/* Broadcast 5-byte HELLO */
 static void
-broadcast_rank(void)
+tree_parent_changed(void)
 {
-  uint8_t buf[5] = {
-    1,
-    (uint8_t)(my_rank>>8), (uint8_t)my_rank,
-    (uint8_t)battery_level,
-    (uint8_t)power_state
-  };
-  nullnet_buf = buf;
-  nullnet_len = sizeof(buf);
-  battery_level -= COST_HELLO;
-  NETSTACK_NETWORK.output(NULL);
-  printf("TREE : Node %u: HELLO rank=%u bat=%u state=%u\n",
-         linkaddr_node_addr.u8[0], my_rank, buf[3], buf[4]);
 }
 
-/* Handle sensor readings only */
+static const struct tree_callbacks tree_cb = {
+  energy_battery, tree_state, tree_hello_sent, tree_parent_changed,
+  duty_cycle_next_window, duty_cycle_phase
+};
+
+/* Re-schedule the radio and advertise the new state quickly */
+static void
+power_state_changed(void)
+{
+  duty_cycle_update();
+  tree_reset();
+  telemetry_state_changed();
+}
+
+/* Report one reading to the server */
+static void
+handle_reading(uint8_t node, uint8_t seq, uint16_t value, uint8_t ttl,
+               const struct trace *t)
+{
+  if(TRACE_ENABLED && t) {
+    trace_log("server", node, seq, t);
+  }
+  serial_proto_reading(node, seq, value);
+}
+
+/* Report one computation node's summary of a sensor to the server */
+static void
+handle_summary(const struct aggregate_summary *s)
+{
+  serial_proto_summary(s);
+}
+
+/* Report one node's energy report to the server */
+static void
+handle_telemetry(const struct telemetry_report *r)
+{
+  serial_proto_telemetry(r);
+}
+
+/* Our own report, outside any radio frame */
+static void
+local_telemetry(const struct telemetry_report *r)
+{
+  serial_proto_telemetry(r);
+  serial_proto_flush();
+}
+
+/* How a command from the server ended */
+static void
+command_done(uint8_t node, uint16_t code, uint8_t tries, uint32_t ms)
+{
+  EVLOG32(EVLOG_INFO, ms ? EV_CMD_ACKED : EV_CMD_FAILED, node,
+          EV_CMD_SERVER | EV_CMD_OUTCOME(tries, ms));
+}
+
+/* Handle HELLOs, acks and upstream frames, one charge per frame */
 static void
 input_callback(const void *data, uint16_t len,
                const linkaddr_t *src, const linkaddr_t *dest)
 {
-  if(len==4) {
-    const uint8_t *buf = data;
-    if(buf[0]==2) {
-      packet_t pkt;
-      memcpy(&pkt, data, sizeof(pkt));
-      printf("PROCESS : Server got ID=%u, value=%u\n", pkt.node, pkt.value);
-      battery_level -= COST_FORWARD;
-    }
+  /* NullNet leaves feeding link-stats to us */
+  link_stats_input_callback(src);
+  /* listening cost so far, before this frame changes anything */
+  energy_update();
+
+  if(tree_input(data, len, src)) {
+    return;
+  }
+  if(command_input(data, len, src, NULL) != COMMAND_NONE) {
+    return;
+  }
+  if(batch_input(data, len, src, handle_reading) > 0
+     || aggregate_input(data, len, src, handle_summary) > 0
+     || telemetry_input(data, len, src, handle_telemetry) > 0) {
+    /* one serial frame per radio frame in binary mode */
+    serial_proto_flush();
+    energy_charge(ENERGY_FORWARD);
   }
 }
 
@@ -105,58 +128,42 @@ PROCESS_THREAD(border_router_process, ev, data)
   /* allow PC→mote commands */
   serial_line_init();
   nullnet_set_input_callback(input_callback);
-
-  energest_init();
-  energest_flush();
-  last_cpu = energest_type_time(ENERGEST_TYPE_CPU);
-  last_lpm = energest_type_time(ENERGEST_TYPE_LPM);
-  last_tx  = energest_type_time(ENERGEST_TYPE_TRANSMIT);
-  last_rx  = energest_type_time(ENERGEST_TYPE_LISTEN);
-  etimer_set(&energy_timer, CLOCK_SECOND);
-
-  my_rank = 0xFFFF;
-  if(linkaddr_node_addr.u8[0]==BORDER_NODE_ID) {
-    my_rank=0;
-    printf("TREE : Node %u: I am root (rank 0)\n",
-           linkaddr_node_addr.u8[0]);
-  }
-  etimer_set(&hello_timer, random_rand()%HELLO_INTERVAL);
+  batch_init();
+  command_init(command_done);
+  /* commands wait for the child's listen window */
+  command_set_gate(duty_cycle_hop_wait);
+  /* and keep our radio on for their acks */
+  command_set_hold(duty_cycle_hold);
+
+  duty_cycle_init();
+  energy_init(power_state_changed);
+  telemetry_init(local_telemetry);
+  tree_init(&tree_cb, 1);
 
   while(1) {
     PROCESS_WAIT_EVENT();
 
-    /* PC commands → radio */
+    /* PC commands → radio, as a binary frame or "<type> <node> <code>" */
     if(ev == serial_line_event_message) {
       char *line = (char*)data;
       uint8_t t, n; uint16_t c;
-      if(sscanf(line, "%hhu %hhu %hu", &t, &n, &c)==3) {
-        uint8_t cmd[4] = {t,n};
-        memcpy(cmd+2,&c,sizeof(c));
-        nullnet_buf = cmd; nullnet_len = sizeof(cmd);
-        linkaddr_t dst = {{n}};
-        NETSTACK_NETWORK.output(&dst);
-        battery_level -= COST_FORWARD;
-        printf("BORDER: Sent cmd type=%u to %u\n", t, n);
+      uint8_t rec, p[SERIAL_MAX_PAYLOAD];
+      int ok;
+      if((uint8_t)line[0] == SERIAL_SYNC) {
+        ok = serial_proto_decode(line, &rec, p, sizeof(p)) == 4
+          && rec == SERIAL_REC_COMMAND;
+        if(ok) {
+          t = p[0]; n = p[1]; memcpy(&c, &p[2], sizeof(c));
+        }
+      } else {
+        ok = sscanf(line, "%hhu %hhu %hu", &t, &n, &c)==3;
+      }
+      if(ok && t==MSG_COMMAND) {
+        /* down the tree along the routes learnt from readings */
+        const linkaddr_t *via = command_send(n, c, NULL);
+        energy_charge(ENERGY_FORWARD);
+        EVLOG(EVLOG_INFO, EV_CMD_SENT, n, via->u8[0], t);
       }
-      continue;
-    }
-
-    /* Battery & modes */
-    if(etimer_expired(&energy_timer)) {
-      update_battery();
-      static uint8_t lpmc, dpc;
-      if(power_state==STATE_LPM      && ++lpmc>=10)    { battery_level+=1; lpmc=0; }
-      if(power_state==STATE_DEEP_LPM && ++dpc>=2)      { battery_level+=1; dpc=0; }
-      if(power_state==STATE_ACTIVE   && battery_level<=LPM_THRESHOLD)      power_state=STATE_LPM;
-      if(power_state==STATE_LPM      && battery_level<=DEEP_LPM_THRESHOLD) power_state=STATE_DEEP_LPM;
-      if(power_state==STATE_DEEP_LPM && battery_level>=WAKE_THRESHOLD)     power_state=STATE_ACTIVE;
-      etimer_reset(&energy_timer);
-    }
-
-    /* HELLO */
-    if(etimer_expired(&hello_timer)) {
-      broadcast_rank();
-      etimer_reset(&hello_timer);
     }
   }
 
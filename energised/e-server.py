@@ -1,10 +1,13 @@
 # server.py
+import argparse
+import collections
+import errno
+import re
+import selectors
 import socket
-import time
 import struct
-import threading
-from collections import deque, defaultdict
-import re
+import time
+from array import array
 
 # Configuration
 HOST = '127.0.0.1'
@@ -12,106 +15,596 @@ PORT = 60001
 WINDOW_SIZE = 30           # number of samples
 WINDOW_EXPIRY = 300        # seconds: expire data older than this
 SLOPE_THRESHOLD = 0.5      # slope threshold to trigger valve
+RETRY_DELAY = 2            # seconds between connection attempts
+FLUSH_TIME = 0.1           # seconds of backlog discarded after connecting
+STATS_INTERVAL = 10        # seconds between throughput reports
+DUP_WINDOW = 600           # seconds a (node, seq) pair counts as seen
+ENERGY_INTERVAL = 300      # seconds between energy reports
+ENERGY_WINDOW = 4          # telemetry reports a node's rates are taken over
+RECV_SIZE = 4096
 
 # Pre-compute sums for fixed-interval indices
 SUM_I = sum(range(WINDOW_SIZE))
 SUM_I2 = sum(i * i for i in range(WINDOW_SIZE))
+DEN = WINDOW_SIZE * SUM_I2 - SUM_I * SUM_I
+
+# Regex to parse lines like: "PROCESS : Server got ID=3, seq=7, value=42"
+# (seq is absent in older firmware)
+LINE_RE = re.compile(rb"ID=(\d+),\s*(?:seq=(\d+),\s*)?value=(\d+)")
+# ... and "Server got summary ID=3, by=9, epoch=4, n=5, min=1, max=9,
+# mean=4, slope=0.25"
+SUMMARY_RE = re.compile(rb"summary ID=(\d+), by=(\d+), epoch=(\d+), "
+                        rb"n=(\d+), min=(\d+), max=(\d+), mean=(\d+), "
+                        rb"slope=(-?[\d.]+)")
+SUMMARY_MIN_COUNT = 4      # fewer samples give too noisy a slope to act on
+# ... and "ENERGY : Server got report ID=3, seq=0, state=1, bat=58.3%,
+# t=1800 s, cpu=3, lpm=1799, tx=1, listen=1799 ms, hello=2, ..., forward=0"
+ENERGY_RE = re.compile(rb"report ID=(\d+), seq=(\d+), state=(\d+), "
+                       rb"bat=(-?[\d.]+)%, t=(\d+) s, cpu=(\d+), lpm=(\d+), "
+                       rb"tx=(\d+), listen=(\d+) ms, hello=(\d+), "
+                       rb"sensor_tx=(\d+), valve_rx=(\d+), command_tx=(\d+), "
+                       rb"forward=(\d+)")
+
+# Binary serial frames (see serial-proto.h): one line each,
+# SYNC + stuffed(len, type, payload, crc16 LE) + '\n'
+SYNC = 0xA5
+ESC = 0x7D
+ESCAPED = {0x00, 0x0A, 0x0D, SYNC, ESC}
+REC_READINGS = 1
+REC_COMMAND = 2
+REC_SUMMARY = 3
+REC_EVENTS = 4             # event logs, for ../evlog.py; skipped here
+REC_TELEMETRY = 5
+MSG_COMMAND = 3
+binary_commands = False    # --binary: send commands as frames too
+
+
+# The firmware's battery model (energy.c), in percent of a full battery
+ACTIVITIES = ("cpu", "lpm", "tx", "listen")
+ACTIVITY_RATE = (0.2, 0.02, 1.0, 1.0)            # per second active
+CHARGES = ("hello", "sensor_tx", "valve_rx", "command_tx", "forward")
+CHARGE_COST = (1, 3, 1, 2, 1)                    # per event
+STATES = ("ACTIVE", "LPM", "DEEP")
+
+
+def crc16(data, acc=0):
+    """Contiki's lib/crc16.c (CRC-16/KERMIT)."""
+    for b in data:
+        acc ^= b
+        acc = ((acc >> 8) | (acc << 8)) & 0xFFFF
+        acc ^= (acc & 0xFF00) << 4 & 0xFFFF
+        acc ^= (acc >> 8) >> 4
+        acc ^= (acc & 0xFF00) >> 5
+    return acc
+
+
+def encode_frame(rec_type, payload):
+    body = bytes([len(payload), rec_type]) + payload
+    body += struct.pack('<H', crc16(body))
+    out = bytearray([SYNC])
+    for b in body:
+        if b in ESCAPED:
+            out += bytes([ESC, b ^ 0x20])
+        else:
+            out.append(b)
+    out += b'\n'
+    return bytes(out)
+
+
+def decode_frame(line):
+    """Return (type, payload) of a binary frame line, None if invalid."""
+    raw = bytearray()
+    it = iter(line[1:])
+    for b in it:
+        if b == ESC:
+            b = next(it, None)
+            if b is None:
+                return None
+            b ^= 0x20
+        raw.append(b)
+    if len(raw) < 4 or raw[0] != len(raw) - 4:
+        return None
+    if crc16(raw[:-2]) != struct.unpack_from('<H', raw, len(raw) - 2)[0]:
+        return None
+    return raw[1], bytes(raw[2:-2])
+
+
+class SlopeEngine:
+    """Sliding-window regression for every node, O(1) per reading.
+
+    Each node gets a slot: WINDOW_SIZE entries in preallocated value and
+    timestamp rings, plus sum_v = sum(v_k) and sum_iv = sum(k * v_k) with
+    k = 0 the oldest, kept up to date as in common/slope-window.c. push()
+    only updates the sums and marks the slot; evaluate() then computes the
+    slopes of every marked full window in one pass, once per batch of
+    input instead of once per reading.
+    """
+
+    GROW = 1024    # slots added at a time
+
+    def __init__(self, size, expiry):
+        self.size = size
+        self.expiry = expiry
+        self.slot_of = {}              # node_id -> slot
+        self.node_of = []              # slot -> node_id
+        self.values = array('l')
+        self.stamps = array('d')
+        self.head = array('l')         # ring index of the oldest entry
+        self.count = array('l')
+        self.sum_v = array('q')
+        self.sum_iv = array('q')
+        self.dirty = set()
+
+    def __len__(self):
+        return len(self.node_of)
+
+    def _slot(self, node_id):
+        slot = self.slot_of.get(node_id)
+        if slot is None:
+            slot = len(self.node_of)
+            if slot == len(self.count):
+                n = self.GROW
+                for a in (self.values, self.stamps):
+                    a.extend(array(a.typecode, [0]) * (n * self.size))
+                for a in (self.head, self.count, self.sum_v, self.sum_iv):
+                    a.extend(array(a.typecode, [0]) * n)
+            self.slot_of[node_id] = slot
+            self.node_of.append(node_id)
+        return slot
+
+    def _drop_oldest(self, slot):
+        base = slot * self.size
+        h = self.head[slot]
+        self.sum_v[slot] -= self.values[base + h]
+        # every remaining k moves down by one
+        self.sum_iv[slot] -= self.sum_v[slot]
+        self.head[slot] = (h + 1) % self.size
+        self.count[slot] -= 1
+
+    def push(self, node_id, value, now):
+        slot = self._slot(node_id)
+        base = slot * self.size
+        # timestamp-based expiry from the oldest end
+        while (self.count[slot]
+               and now - self.stamps[base + self.head[slot]] > self.expiry):
+            self._drop_oldest(slot)
+        if self.count[slot] == self.size:
+            self._drop_oldest(slot)
+        n = self.count[slot]
+        i = base + (self.head[slot] + n) % self.size
+        self.values[i] = value
+        self.stamps[i] = now
+        self.sum_iv[slot] += n * value
+        self.sum_v[slot] += value
+        self.count[slot] = n + 1
+        self.dirty.add(slot)
+
+    def clear(self, node_id):
+        slot = self.slot_of.get(node_id)
+        if slot is not None:
+            self.count[slot] = self.sum_v[slot] = self.sum_iv[slot] = 0
+
+    def evaluate(self):
+        """(node_id, slope) of every window that changed and is full."""
+        size, count = self.size, self.count
+        sum_v, sum_iv, node_of = self.sum_v, self.sum_iv, self.node_of
+        out = [(node_of[s], (size * sum_iv[s] - SUM_I * sum_v[s]) / DEN)
+               for s in self.dirty if count[s] == size]
+        self.dirty.clear()
+        return out
+
+
+class SeenFilter:
+    """Readings already taken, by (node, seq).
+
+    With several border routers, and parents chosen per frame, the same
+    reading can reach the server through more than one sink. seq is one
+    byte, so a pair only counts as seen for DUP_WINDOW seconds, well
+    short of a wrap at one reading a minute.
+    """
+
+    def __init__(self, window):
+        self.window = window
+        self.last = {}                 # node_id -> array of 256 times
+
+    def check(self, node_id, seq, now):
+        """True if (node_id, seq) was seen recently; marks it seen."""
+        times = self.last.get(node_id)
+        if times is None:
+            times = self.last[node_id] = array('d', [-self.window]) * 256
+        dup = now - times[seq] < self.window
+        times[seq] = now
+        return dup
+
+
+class EnergyTable:
+    """Where each node's battery goes, from its telemetry reports.
+
+    A report covers the span since the node's previous one: the time its
+    CPU ran, slept, sent and listened, and the one-off charges it paid.
+    Priced with the firmware's battery model that is a drain per cause;
+    the battery it reports gives the net rate once harvesting is in. Both
+    rates are taken over the last ENERGY_WINDOW reports, and a node still
+    losing charge is projected to run flat at that net rate.
+    """
+
+    def __init__(self, window):
+        self.window = window
+        self.nodes = {}                # node_id -> state, see _node()
+        self.duplicates = 0
+
+    def _node(self, node_id):
+        n = self.nodes.get(node_id)
+        if n is None:
+            n = self.nodes[node_id] = {
+                "seq": None, "state": 0, "battery": 0.0, "span": 0,
+                "drain": [0.0] * (len(ACTIVITIES) + len(CHARGES)),
+                "recent": collections.deque(maxlen=self.window),
+            }
+        return n
+
+    def add(self, node_id, seq, state, battery, period, ms, charges):
+        n = self._node(node_id)
+        if seq == n["seq"]:
+            # the same report through another sink
+            self.duplicates += 1
+            return
+        drain = [t / 1000 * r for t, r in zip(ms, ACTIVITY_RATE)]
+        drain += [c * k for c, k in zip(charges, CHARGE_COST)]
+        n["drain"] = [a + b for a, b in zip(n["drain"], drain)]
+        n["span"] += period
+        # battery lost over the period; needs the previous report
+        net = n["battery"] - battery if n["seq"] is not None else None
+        n["recent"].append((period, sum(drain), net))
+        n["seq"], n["state"], n["battery"] = seq, state, battery
+
+    def rates(self, n):
+        """(drain, net) in percent per hour over the recent reports."""
+        recent = n["recent"]
+        span = sum(p for p, _, _ in recent)
+        drain = sum(d for _, d, _ in recent) * 3600 / span if span else 0.0
+        nets = [(p, x) for p, _, x in recent if x is not None]
+        net_span = sum(p for p, _ in nets)
+        net = sum(x for _, x in nets) * 3600 / net_span if net_span else None
+        return drain, net
+
+    def report(self, top=None):
+        """Nodes by drain rate, hottest first, with the cause breakdown."""
+        rows = []
+        for node_id, n in self.nodes.items():
+            drain, net = self.rates(n)
+            rows.append((drain, node_id, n, net))
+        rows.sort(key=lambda r: (-r[0], r[1]))
+        if top:
+            rows = rows[:top]
+        if not rows:
+            return
+        causes = ACTIVITIES + CHARGES
+        print(f"ENERGY: {len(self.nodes)} nodes reporting, "
+              f"{self.duplicates} duplicate reports; "
+              f"drain and net in %/h, causes in % of drain")
+        print("ENERGY: node state  bat  drain    net  flat_in  "
+              + " ".join(f"{c:>10}" for c in causes))
+        for drain, node_id, n, net in rows:
+            total = sum(n["drain"]) or 1.0
+            if net is None:
+                net_s, flat = "?", "?"
+            else:
+                net_s = f"{net:.1f}"
+                flat = (f"{max(n['battery'], 0) / net:.1f}h" if net > 0
+                        else "never")
+            print(f"ENERGY: {node_id:4d} {STATES[n['state']]:>6} "
+                  f"{n['battery']:4.0f} {drain:6.1f} {net_s:>6} {flat:>8}  "
+                  + " ".join(f"{100 * d / total:10.1f}" for d in n["drain"]))
 
-# Data store: node_id -> deque of (timestamp, value)
-data_windows = defaultdict(lambda: deque(maxlen=WINDOW_SIZE))
-lock = threading.Lock()
-
-# Regex to parse lines like: "PROCESS : Server got ID=3, value=42"
-LINE_RE = re.compile(r"ID=(\d+),\s*value=(\d+)")
-
-
-def compute_slope_fixed(values):
-    n = len(values)
-    sum_v = sum(values)
-    sum_iv = sum(i * values[i] for i in range(n))
-    num = n * sum_iv - SUM_I * sum_v
-    den = n * SUM_I2 - SUM_I * SUM_I
-    return (num / den) if den != 0 else 0.0
-
-
-def handle_reading(node_id, value, sock):
-    now = time.time()
-    with lock:
-        dq = data_windows[node_id]
-        # Remove expired data
-        while dq and now - dq[0][0] > WINDOW_EXPIRY:
-            dq.popleft()
-        # Append new reading (oldest auto removed when maxlen reached)
-        dq.append((now, value))
-        # Compute slope once we have exactly WINDOW_SIZE points
-        if len(dq) == WINDOW_SIZE:
-            values = [v for (_, v) in dq]
-            slope = compute_slope_fixed(values)
-            print(f"Node {node_id}: slope={slope:.3f} based on {len(dq)} pts")
-            if slope > SLOPE_THRESHOLD:
-                print(f"--> Triggering OPEN_VALVE for node {node_id}")
-                # Pack message: type=3 (open valve), node_id, code=1
-
-                cmd = f"3 {node_id} 1\n"
-                sock.send(cmd.encode('ascii'))
-                print(f"→ Sent ASCII cmd: {cmd.strip()}")
-                dq.clear()  # clear after triggering
-
-
-def serial_listener(sock):
-    buffer = b''
-    while True:
+
+# Windows of every node. Only the event loop touches them, so no lock is
+# needed.
+engine = SlopeEngine(WINDOW_SIZE, WINDOW_EXPIRY)
+seen = SeenFilter(DUP_WINDOW)
+# ... and summaries, by ((origin, node), epoch); an epoch is 5 minutes
+seen_summaries = SeenFilter(DUP_WINDOW)
+energy = EnergyTable(ENERGY_WINDOW)
+# Sink each node was last heard through, where its command goes
+node_conn = {}
+quiet = False              # --quiet: no per-node slope lines
+
+
+class Stats:
+    """Counters reported every STATS_INTERVAL seconds."""
+
+    def __init__(self):
+        self.lines = 0
+        self.readings = 0
+        self.duplicates = 0
+        self.commands = 0
+        self.bytes_in = 0
+        self.bad_frames = 0
+        self.last_report = time.monotonic()
+
+    def report(self, conns):
+        now = time.monotonic()
+        dt = now - self.last_report
+        if dt < STATS_INTERVAL:
+            return
+        rx_backlog = sum(len(c.rbuf) for c in conns)
+        tx_backlog = sum(len(c.wbuf) for c in conns)
+        live = sum(1 for c in conns if c.sock is not None)
+        print(f"STATS : {live}/{len(conns)} sinks, "
+              f"{self.lines / dt:.1f} lines/s, {self.readings / dt:.1f} readings/s, "
+              f"{self.duplicates} duplicates, "
+              f"{self.bytes_in / dt:.0f} B/s in, {self.commands} cmds, "
+              f"{self.bad_frames} bad frames, "
+              f"rx backlog={rx_backlog} B, tx queue={tx_backlog} B, "
+              f"nodes={len(engine)}")
+        self.lines = self.readings = self.commands = self.bytes_in = 0
+        self.duplicates = 0
+        self.bad_frames = 0
+        self.last_report = now
+
+
+stats = Stats()
+
+
+class SinkConnection:
+    """One non-blocking connection to a Cooja SerialSocketServer."""
+
+    def __init__(self, sel, host, port):
+        self.sel = sel
+        self.host = host
+        self.port = port
+        self.sock = None
+        self.rbuf = bytearray()
+        self.wbuf = bytearray()
+        self.connecting = False
+        self.retry_at = 0.0
+        self.flush_until = 0.0
+
+    def __str__(self):
+        return f"{self.host}:{self.port}"
+
+    # -- connection management -------------------------------------------
+    def connect(self):
+        print(f"Connecting to {self}...")
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.sock.setblocking(False)
+        self.connecting = True
+        self.sel.register(self.sock, selectors.EVENT_WRITE, self)
+        err = self.sock.connect_ex((self.host, self.port))
+        if err not in (0, errno.EINPROGRESS, errno.EWOULDBLOCK):
+            self.close("connection refused")
+
+    def close(self, why):
+        print(f"{self}: {why}, retrying in {RETRY_DELAY} seconds...")
+        self.sel.unregister(self.sock)
+        self.sock.close()
+        self.sock = None
+        self.rbuf.clear()
+        self.wbuf.clear()
+        self.retry_at = time.monotonic() + RETRY_DELAY
+
+    def update_events(self):
+        events = selectors.EVENT_READ
+        if self.wbuf or self.connecting:
+            events |= selectors.EVENT_WRITE
+        self.sel.modify(self.sock, events, self)
+
+    # -- I/O ---------------------------------------------------------------
+    def on_event(self, mask):
+        if self.connecting:
+            err = self.sock.getsockopt(socket.SOL_SOCKET, socket.SO_ERROR)
+            if err:
+                self.close("connection refused")
+                return
+            self.connecting = False
+            # Flush any backlog from Cooja before live processing
+            self.flush_until = time.monotonic() + FLUSH_TIME
+            print(f"Connected to Cooja serial port {self}.")
+            self.update_events()
+            return
+        if mask & selectors.EVENT_READ:
+            self.on_readable()
+        if self.sock is not None and mask & selectors.EVENT_WRITE:
+            self.on_writable()
+
+    def on_readable(self):
         try:
-            chunk = sock.recv(1024)
-            if not chunk:
-                print("Connection closed by Cooja, exiting listener.")
+            chunk = self.sock.recv(RECV_SIZE)
+        except (BlockingIOError, InterruptedError):
+            return
+        except OSError as e:
+            self.close(f"error {e}")
+            return
+        if not chunk:
+            self.close("connection closed by Cooja")
+            return
+        if time.monotonic() < self.flush_until:
+            return
+        stats.bytes_in += len(chunk)
+        self.rbuf += chunk
+        self.frame_lines()
+
+    def frame_lines(self):
+        # Scan for complete lines in place, then drop them in one go
+        buf = self.rbuf
+        start = 0
+        now = time.time()
+        while True:
+            end = buf.find(b'\n', start)
+            if end < 0:
                 break
-            buffer += chunk
-            while b'\n' in buffer:
-                line, buffer = buffer.split(b'\n', 1)
-                text = line.decode('ascii', errors='ignore').strip()
-                m = LINE_RE.search(text)
+            stats.lines += 1
+            if buf[start] == SYNC:
+                self.handle_frame(buf[start:end], now)
+            elif buf.find(b"ENERGY", start, end) >= 0:
+                m = ENERGY_RE.search(buf, start, end)
+                if m:
+                    g = m.groups()
+                    energy.add(int(g[0]), int(g[1]), int(g[2]), float(g[3]),
+                               int(g[4]), [int(x) for x in g[5:9]],
+                               [int(x) for x in g[9:14]])
+            elif buf.find(b"summary", start, end) >= 0:
+                m = SUMMARY_RE.search(buf, start, end)
+                if m:
+                    g = m.groups()
+                    handle_summary(int(g[0]), int(g[1]), int(g[2]),
+                                   int(g[3]), int(g[4]), int(g[5]),
+                                   int(g[6]), float(g[7]), now, self)
+            else:
+                m = LINE_RE.search(buf, start, end)
                 if m:
-                    node_id = int(m.group(1))
-                    value = int(m.group(2))
-                    handle_reading(node_id, value, sock)
-        except Exception as e:
-            print("Error in serial listener:", e)
-            break
+                    seq = m.group(2)
+                    handle_reading(int(m.group(1)),
+                                   None if seq is None else int(seq),
+                                   int(m.group(3)), now, self)
+            start = end + 1
+        if start:
+            del buf[:start]
+        # one pass over the windows this chunk touched
+        evaluate_slopes()
 
+    def handle_frame(self, line, now):
+        frame = decode_frame(line)
+        if frame is None:
+            stats.bad_frames += 1
+            return
+        rec_type, payload = frame
+        if rec_type == REC_READINGS:
+            for node_id, seq, value in struct.iter_unpack('<BBH', payload):
+                handle_reading(node_id, seq, value, now, self)
+        elif rec_type == REC_SUMMARY:
+            for (node_id, origin, epoch, count, lo, hi, mean,
+                 slope) in struct.iter_unpack('<BBBBHHHh', payload):
+                handle_summary(node_id, origin, epoch, count, lo, hi, mean,
+                               slope / 1000, now, self)
+        elif rec_type == REC_TELEMETRY:
+            for rec in struct.iter_unpack('<BBBhH4H5B', payload):
+                node_id, seq, state, battery, period = rec[:5]
+                # each activity as a share of the period, in 1/65536
+                ms = [s * period * 1000 >> 16 for s in rec[5:9]]
+                energy.add(node_id, seq, state, battery / 10, period, ms,
+                           list(rec[9:]))
 
-def main():
-    # Connect to Cooja's serial socket
-    while True:
+    def on_writable(self):
         try:
-            print(f"Connecting to {HOST}:{PORT}...")
-            sock = socket.create_connection((HOST, PORT))
-            print("Connected to Cooja serial port.")
-            # Flush any backlog from Cooja
-            sock.settimeout(0.1)
-            try:
-                while True:
-                    sock.recv(1024)
-            except socket.timeout:
-                pass
-            sock.settimeout(None)
-            print("Buffer flushed; starting live processing.")
-            break
-        except ConnectionRefusedError:
-            print("Connection refused, retrying in 2 seconds...")
-            time.sleep(2)
-
-    # Start listener thread
-    listener = threading.Thread(target=serial_listener, args=(sock,), daemon=True)
-    listener.start()
-
-    # Keep main thread alive
+            sent = self.sock.send(self.wbuf)
+        except (BlockingIOError, InterruptedError):
+            return
+        except OSError as e:
+            self.close(f"error {e}")
+            return
+        del self.wbuf[:sent]
+        self.update_events()
+
+    def send(self, data):
+        if self.sock is None or self.connecting:
+            return
+        self.wbuf += data
+        self.update_events()
+
+
+def open_valve(node_id, conn):
+    print(f"--> Triggering OPEN_VALVE for node {node_id}")
+    # Pack message: type=3 (open valve), node_id, code=1
+    if binary_commands:
+        payload = struct.pack('<BBH', MSG_COMMAND, node_id, 1)
+        conn.send(encode_frame(REC_COMMAND, payload))
+        print(f"→ Sent binary cmd: 3 {node_id} 1 via {conn}")
+    else:
+        cmd = f"3 {node_id} 1\n"
+        conn.send(cmd.encode('ascii'))
+        print(f"→ Sent ASCII cmd: {cmd.strip()} via {conn}")
+    stats.commands += 1
+
+
+def handle_summary(node_id, origin, epoch, count, lo, hi, mean, slope, now,
+                   conn):
+    """One epoch of a sensor, summarised by computation node `origin`."""
+    if seen_summaries.check((origin, node_id), epoch, now):
+        stats.duplicates += 1
+        return
+    stats.readings += count
+    print(f"Node {node_id}: slope={slope:.3f} over {count} pts "
+          f"(min={lo}, max={hi}, mean={mean}, summarised)")
+    if count >= SUMMARY_MIN_COUNT and slope > SLOPE_THRESHOLD:
+        open_valve(node_id, conn)
+
+
+def handle_reading(node_id, seq, value, now, conn):
+    # a command goes back through the sink that last heard its target
+    node_conn[node_id] = conn
+    if seq is not None and seen.check(node_id, seq, now):
+        stats.duplicates += 1
+        return
+    stats.readings += 1
+    engine.push(node_id, value, now)
+
+
+def evaluate_slopes():
+    for node_id, slope in engine.evaluate():
+        if not quiet:
+            print(f"Node {node_id}: slope={slope:.3f} "
+                  f"based on {WINDOW_SIZE} pts")
+        if slope > SLOPE_THRESHOLD:
+            open_valve(node_id, node_conn[node_id])
+            engine.clear(node_id)  # clear after triggering
+
+
+def parse_endpoint(text):
+    host, _, port = text.rpartition(':')
+    return (host or HOST), int(port)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Collect readings from one or more Cooja serial sockets")
+    parser.add_argument('endpoints', nargs='*', default=[f"{HOST}:{PORT}"],
+                        help="host:port of each SerialSocketServer "
+                             f"(default {HOST}:{PORT})")
+    parser.add_argument('--sinks', type=int, default=0,
+                        help=f"connect to N border routers on {HOST}:{PORT} "
+                             "and the ports after it, as scenario.py "
+                             "--roots sets them up")
+    parser.add_argument('--binary', action='store_true',
+                        help="send commands as binary frames (readings are "
+                             "decoded in either format)")
+    parser.add_argument('--quiet', action='store_true',
+                        help="no per-node slope lines, only STATS and "
+                             "commands")
+    parser.add_argument('--energy-top', type=int, default=10,
+                        help="nodes listed in each ENERGY report, hottest "
+                             "first (0: all; the report at exit lists all)")
+    args = parser.parse_args()
+
+    global binary_commands, quiet
+    binary_commands = args.binary
+    quiet = args.quiet
+
+    sel = selectors.DefaultSelector()
+    endpoints = [parse_endpoint(e) for e in args.endpoints]
+    if args.sinks:
+        endpoints = [(HOST, PORT + k) for k in range(args.sinks)]
+    conns = [SinkConnection(sel, *e) for e in endpoints]
+    next_energy = time.monotonic() + ENERGY_INTERVAL
+
     try:
-        while listener.is_alive():
-            time.sleep(1)
+        while True:
+            now = time.monotonic()
+            if now >= next_energy:
+                energy.report(args.energy_top)
+                next_energy = now + ENERGY_INTERVAL
+            for c in conns:
+                if c.sock is None and now >= c.retry_at:
+                    c.connect()
+            for key, mask in sel.select(timeout=1.0):
+                key.data.on_event(mask)
+            stats.report(conns)
     except KeyboardInterrupt:
+        energy.report()
         print("Shutting down server.")
-        sock.close()
+        for c in conns:
+            if c.sock is not None:
+                c.sock.close()
 
 
 if __name__ == '__main__':
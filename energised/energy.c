@@ -0,0 +1,194 @@
+/* energy.c */
+
+#include "energy.h"
+#include "energest.h"
+#include "evlog.h"
+
+/* Drain while active, in millionths of the battery per second */
+static const uint16_t activity_rate[] = {
+  2000,     /* CPU      0.2 %/s  */
+  200,      /* LPM      0.02 %/s */
+  10000,    /* TRANSMIT 1 %/s    */
+  10000     /* LISTEN   1 %/s    */
+};
+static const uint8_t activity_type[] = {
+  ENERGEST_TYPE_CPU, ENERGEST_TYPE_LPM,
+  ENERGEST_TYPE_TRANSMIT, ENERGEST_TYPE_LISTEN
+};
+#define ACTIVITY_COUNT  (sizeof(activity_type) / sizeof(activity_type[0]))
+
+/* Recharge per second spent in each power state */
+static const uint16_t recharge_rate[] = {
+  0,        /* ACTIVE              */
+  1000,     /* LPM      1 % / 10 s */
+  5000      /* DEEP_LPM 1 % / 2 s  */
+};
+
+/* Price of each one-off event, indexed by enum energy_event */
+static const uint16_t event_cost[ENERGY_EVENT_COUNT] = {
+  ENERGY_PERCENT(1),    /* HELLO      */
+  ENERGY_PERCENT(3),    /* SENSOR_TX  */
+  ENERGY_PERCENT(1),    /* VALVE_RX   */
+  ENERGY_PERCENT(2),    /* COMMAND_TX */
+  ENERGY_PERCENT(1)     /* FORWARD    */
+};
+
+struct energy_stats energy_stats;
+
+static int32_t          level = ENERGY_BATTERY_MAX;
+static enum power_state state = POWER_ACTIVE;
+static uint32_t         last_time[ACTIVITY_COUNT];
+static clock_time_t     last_clock;
+static struct ctimer    update_timer;
+
+/* Background drain, measured over at least ENERGY_RATE_WINDOW */
+static uint32_t         drain_rate;       /* per second */
+static uint32_t         window_drain;
+static clock_time_t     window_start;
+static void           (*state_changed)(void);
+
+/*---------------------------------------------------------------------------*/
+/* ticks * rate / per_second without overflowing 32 bits */
+static uint32_t
+scale(uint32_t ticks, uint16_t rate, uint32_t per_second)
+{
+  return (ticks / per_second) * rate
+         + (ticks % per_second) * rate / per_second;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_state(enum power_state s)
+{
+  state = s;
+  EVLOG32(EVLOG_INFO, EV_MODE, s, level / (ENERGY_UNIT / 10));
+  state_changed();
+}
+/*---------------------------------------------------------------------------*/
+/* Time until the current state's threshold is crossed, at the drain rate */
+static clock_time_t
+next_horizon(void)
+{
+  int32_t net = (int32_t)recharge_rate[state] - (int32_t)drain_rate;
+  int32_t gap;
+  uint32_t t;
+
+  switch(state) {
+  case POWER_ACTIVE:
+    gap = level - ENERGY_PERCENT(ENERGY_LPM_THRESHOLD);
+    net = -net;
+    break;
+  case POWER_LPM:
+    gap = level - ENERGY_PERCENT(ENERGY_DEEP_LPM_THRESHOLD);
+    net = -net;
+    break;
+  default:
+    gap = ENERGY_PERCENT(ENERGY_WAKE_THRESHOLD) - level;
+    break;
+  }
+  if(net <= 0) {
+    /* moving away from the threshold */
+    return ENERGY_MAX_HORIZON;
+  }
+  if(gap <= 0) {
+    return ENERGY_MIN_HORIZON;
+  }
+  t = scale(gap, CLOCK_SECOND, net) + 1;
+  if(t < ENERGY_MIN_HORIZON) {
+    return ENERGY_MIN_HORIZON;
+  }
+  return t < ENERGY_MAX_HORIZON ? t : ENERGY_MAX_HORIZON;
+}
+/*---------------------------------------------------------------------------*/
+static void
+timer_expired(void *ptr)
+{
+  energy_update();
+}
+/*---------------------------------------------------------------------------*/
+void
+energy_update(void)
+{
+  uint8_t i;
+  uint32_t drain = 0;
+  clock_time_t now = clock_time();
+
+  energest_flush();
+  for(i = 0; i < ACTIVITY_COUNT; i++) {
+    uint32_t t = energest_type_time(activity_type[i]);
+    drain += scale(t - last_time[i], activity_rate[i],
+                   ENERGY_TICKS_PER_SECOND);
+    last_time[i] = t;
+  }
+  level -= drain;
+  level += scale((clock_time_t)(now - last_clock), recharge_rate[state],
+                 CLOCK_SECOND);
+  last_clock = now;
+  if(level > ENERGY_BATTERY_MAX) {
+    level = ENERGY_BATTERY_MAX;
+  }
+
+  window_drain += drain;
+  if((clock_time_t)(now - window_start) >= ENERGY_RATE_WINDOW) {
+    drain_rate = scale(window_drain, CLOCK_SECOND,
+                       (clock_time_t)(now - window_start));
+    window_drain = 0;
+    window_start = now;
+  }
+
+  if(state == POWER_ACTIVE
+     && level <= ENERGY_PERCENT(ENERGY_LPM_THRESHOLD)) {
+    set_state(POWER_LPM);
+  }
+  if(state == POWER_LPM
+     && level <= ENERGY_PERCENT(ENERGY_DEEP_LPM_THRESHOLD)) {
+    set_state(POWER_DEEP_LPM);
+  }
+  if(state == POWER_DEEP_LPM
+     && level >= ENERGY_PERCENT(ENERGY_WAKE_THRESHOLD)) {
+    set_state(POWER_ACTIVE);
+  }
+
+  ctimer_set(&update_timer, next_horizon(), timer_expired, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+energy_init(void (*changed)(void))
+{
+  uint8_t i;
+
+  state_changed = changed;
+  energest_init();
+  energest_flush();
+  for(i = 0; i < ACTIVITY_COUNT; i++) {
+    last_time[i] = energest_type_time(activity_type[i]);
+  }
+  last_clock = window_start = clock_time();
+  ctimer_set(&update_timer, ENERGY_MIN_HORIZON, timer_expired, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+energy_charge(enum energy_event ev)
+{
+  level -= event_cost[ev];
+  energy_stats.charges[ev]++;
+  energy_update();
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+energy_battery(void)
+{
+  return level > 0 ? level / ENERGY_UNIT : 0;
+}
+/*---------------------------------------------------------------------------*/
+int32_t
+energy_level(void)
+{
+  return level;
+}
+/*---------------------------------------------------------------------------*/
+enum power_state
+energy_state(void)
+{
+  return state;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,108 @@
+/* energy.h */
+
+#ifndef ENERGY_H_
+#define ENERGY_H_
+
+#include "contiki.h"
+
+/*
+ * Battery model shared by the three energised roles. The level is kept in
+ * integer millionths of a full battery (ENERGY_UNIT per percent), so no
+ * float maths runs on the mote.
+ */
+#define ENERGY_UNIT          10000L
+#define ENERGY_PERCENT(p)    ((int32_t)((p) * ENERGY_UNIT))
+#define ENERGY_BATTERY_MAX   ENERGY_PERCENT(100)
+
+/* Power-state thresholds, in percent */
+#ifdef ENERGY_CONF_LPM_THRESHOLD
+#define ENERGY_LPM_THRESHOLD       ENERGY_CONF_LPM_THRESHOLD
+#else
+#define ENERGY_LPM_THRESHOLD       30
+#endif
+
+#ifdef ENERGY_CONF_DEEP_LPM_THRESHOLD
+#define ENERGY_DEEP_LPM_THRESHOLD  ENERGY_CONF_DEEP_LPM_THRESHOLD
+#else
+#define ENERGY_DEEP_LPM_THRESHOLD  10
+#endif
+
+#ifdef ENERGY_CONF_WAKE_THRESHOLD
+#define ENERGY_WAKE_THRESHOLD      ENERGY_CONF_WAKE_THRESHOLD
+#else
+#define ENERGY_WAKE_THRESHOLD      90
+#endif
+
+/*
+ * Energest ticks counted as one second of activity. The model was tuned
+ * against CLOCK_SECOND, so that stays the default.
+ */
+#ifdef ENERGY_CONF_TICKS_PER_SECOND
+#define ENERGY_TICKS_PER_SECOND    ENERGY_CONF_TICKS_PER_SECOND
+#else
+#define ENERGY_TICKS_PER_SECOND    CLOCK_SECOND
+#endif
+
+/*
+ * Accounting is lazy: energest is sampled when a packet is sent or
+ * received, and a single timer is armed for the predicted next threshold
+ * crossing, clamped to these bounds.
+ */
+#ifdef ENERGY_CONF_MIN_HORIZON
+#define ENERGY_MIN_HORIZON         ENERGY_CONF_MIN_HORIZON
+#else
+#define ENERGY_MIN_HORIZON         CLOCK_SECOND
+#endif
+
+#ifdef ENERGY_CONF_MAX_HORIZON
+#define ENERGY_MAX_HORIZON         ENERGY_CONF_MAX_HORIZON
+#else
+#define ENERGY_MAX_HORIZON         (CLOCK_SECOND * 60)
+#endif
+
+/* Shortest span the background drain rate is measured over */
+#ifdef ENERGY_CONF_RATE_WINDOW
+#define ENERGY_RATE_WINDOW         ENERGY_CONF_RATE_WINDOW
+#else
+#define ENERGY_RATE_WINDOW         (CLOCK_SECOND * 10)
+#endif
+
+enum power_state {
+  POWER_ACTIVE,
+  POWER_LPM,
+  POWER_DEEP_LPM
+};
+
+/* One-off charges, priced in energy.c */
+enum energy_event {
+  ENERGY_HELLO,         /* HELLO beacon */
+  ENERGY_SENSOR_TX,     /* upstream readings frame, or relayed command */
+  ENERGY_VALVE_RX,      /* command received */
+  ENERGY_COMMAND_TX,    /* OPEN_VALVE issued or relayed */
+  ENERGY_FORWARD,       /* border router: frame passed to the server */
+  ENERGY_EVENT_COUNT
+};
+
+struct energy_stats {
+  uint32_t charges[ENERGY_EVENT_COUNT];   /* one-off charges made */
+};
+extern struct energy_stats energy_stats;
+
+/* Start accounting; state_changed runs after every power-state switch */
+void             energy_init(void (*state_changed)(void));
+
+/* Bring the level up to date and re-check the thresholds */
+void             energy_update(void);
+
+/* Charge a one-off event, then update */
+void             energy_charge(enum energy_event ev);
+
+/* Battery left in whole percent, 0 when flat */
+uint8_t          energy_battery(void);
+
+/* Battery left in ENERGY_UNIT per percent, negative once overdrawn */
+int32_t          energy_level(void);
+
+enum power_state energy_state(void);
+
+#endif /* ENERGY_H_ */
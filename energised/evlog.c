@@ -0,0 +1,183 @@
+/* evlog.c */
+
+#include "evlog.h"
+#include "serial-proto.h"
+#include "slope-window.h"
+#include "net/linkaddr.h"
+#include <stdio.h>
+#include <string.h>
+
+struct evlog_stats evlog_stats;
+
+static uint8_t        ring[EVLOG_RING][EVLOG_RECORD_LEN];
+static uint8_t        head;       /* oldest record */
+static uint8_t        used;
+static uint8_t        lost;       /* since the last frame, saturating */
+static struct ctimer  drain_timer;
+
+/* Records one frame carries */
+#define FRAME_RECORDS  ((SERIAL_MAX_PAYLOAD - EVLOG_HDR_LEN) / EVLOG_RECORD_LEN)
+
+static const char *const mode_names[] = { "WAKE", "LPM", "DEEP LPM" };
+static const char *const lost_names[] = {
+  "no ack", "no HELLO", "poisoned", "rank loop"
+};
+
+/*---------------------------------------------------------------------------*/
+/* The text line the event stands for, as the modules used to print it */
+static void
+print_event(uint8_t id, uint8_t a, uint16_t b, uint16_t c)
+{
+  unsigned me = linkaddr_node_addr.u8[0];
+  uint32_t wide = b | (uint32_t)c << 16;
+  uint32_t bat;
+  unsigned tries = (wide >> 24) & 0x7F;
+
+  switch(id) {
+  case EV_HELLO:
+    printf("TREE : Node %u: HELLO rank=%u bat=%u state=%u\n", me, b, a, c);
+    break;
+  case EV_NEW_PARENT:
+    printf("TREE : Node %u: new parent -> %u (rank=%u, bat=%u)\n",
+           me, a, b, c);
+    break;
+  case EV_PARENT_MOVED:
+    printf("TREE : Node %u: parent %u moved, rank=%u\n", me, a, b);
+    break;
+  case EV_LOST_PARENT:
+    printf("TREE : Node %u: lost parent %u (%s)\n", me, a,
+           b < sizeof(lost_names) / sizeof(lost_names[0])
+           ? lost_names[b] : "?");
+    break;
+  case EV_REPAIRED:
+    printf("TREE : Node %u: repaired in %lu ms\n", me, (unsigned long)wide);
+    break;
+  case EV_ROOT:
+    printf("TREE : Node %u: I am root (rank 0)\n", me);
+    break;
+  case EV_MODE:
+    /* an overdrawn battery goes negative */
+    bat = (int32_t)wide < 0 ? -(int32_t)wide : wide;
+    printf("MODE : Node %u: %s, battery=%s%lu.%lu%%\n", me,
+           a < 3 ? mode_names[a] : "?", (int32_t)wide < 0 ? "-" : "",
+           (unsigned long)(bat / 10), (unsigned long)(bat % 10));
+    break;
+  case EV_SEND_READING:
+    printf("PROCESS : Node %u: send reading %u to %u\n", me, b, a);
+    break;
+  case EV_FORWARD:
+    printf("PROCESS : Node %u: forward sensor %u to %u\n", me, a, b);
+    break;
+  case EV_AGGREGATE:
+    printf("PROCESS : Node %u: aggregate sensor %u\n", me, a);
+    break;
+  case EV_SLOPE:
+    printf("PROCESS : Node %u: slope=" SLOPE_FMT " sensor=%u\n",
+           me, SLOPE_ARGS((int32_t)wide), a);
+    break;
+  case EV_OPEN_VALVE:
+    printf("PROCESS : Node %u: OPEN_VALVE → %u via %u\n", me, a, b);
+    break;
+  case EV_WINDOW_FULL:
+    printf("PROCESS : Node %u: window table full, drop sensor %u "
+           "(drops=%lu)\n", me, a, (unsigned long)wide);
+    break;
+  case EV_VALVE_OPEN:
+    printf("PROCESS : Node %u: valve OPEN\n", me);
+    break;
+  case EV_VALVE_CLOSED:
+    printf("PROCESS : Node %u: valve CLOSED\n", me);
+    break;
+  case EV_DEEP_SKIP:
+    printf("DLPM   : Node %u: in DEEP LPM, skipping sensor send\n", me);
+    break;
+  case EV_CMD_ACKED:
+    if(wide & EV_CMD_SERVER) {
+      printf("BORDER: cmd to %u acked after %lu ms (%u tries)\n", a,
+             (unsigned long)(wide & 0xFFFFFF), tries);
+    } else {
+      printf("PROCESS : Node %u: OPEN_VALVE → %u acked after %lu ms "
+             "(%u tries)\n", me, a, (unsigned long)(wide & 0xFFFFFF), tries);
+    }
+    break;
+  case EV_CMD_FAILED:
+    if(wide & EV_CMD_SERVER) {
+      printf("BORDER: cmd to %u failed (%u tries)\n", a, tries);
+    } else {
+      printf("PROCESS : Node %u: OPEN_VALVE → %u failed (%u tries)\n",
+             me, a, tries);
+    }
+    break;
+  case EV_CMD_SENT:
+    printf("BORDER: Sent cmd type=%u to %u via %u\n", c, a, b);
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+drain_cb(void *ptr)
+{
+  evlog_drain();
+}
+/*---------------------------------------------------------------------------*/
+void
+evlog_put(uint8_t id, uint8_t a, uint16_t b, uint16_t c)
+{
+  uint8_t *rec;
+  uint16_t now;
+
+  evlog_stats.logged++;
+  if(!EVLOG_BINARY) {
+    print_event(id, a, b, c);
+    return;
+  }
+  if(used == EVLOG_RING) {
+    /* overwrite the oldest */
+    head = (head + 1) % EVLOG_RING;
+    used--;
+    evlog_stats.lost++;
+    if(lost < UINT8_MAX) {
+      lost++;
+    }
+  }
+  rec = ring[(head + used++) % EVLOG_RING];
+  now = (uint16_t)clock_time();
+  memcpy(&rec[0], &now, sizeof(now));
+  rec[2] = id;
+  rec[3] = a;
+  memcpy(&rec[4], &b, sizeof(b));
+  memcpy(&rec[6], &c, sizeof(c));
+  if(used >= FRAME_RECORDS) {
+    /* a full frame: send it while awake anyway */
+    evlog_drain();
+  } else if(ctimer_expired(&drain_timer)) {
+    ctimer_set(&drain_timer, EVLOG_DRAIN_DELAY, drain_cb, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+evlog_drain(void)
+{
+  uint8_t frame[SERIAL_MAX_PAYLOAD];
+  uint8_t n;
+  uint32_t now;
+  uint16_t tps = CLOCK_SECOND;
+
+  ctimer_stop(&drain_timer);
+  while(used > 0) {
+    now = clock_time();
+    memcpy(&frame[0], &now, sizeof(now));
+    memcpy(&frame[4], &tps, sizeof(tps));
+    frame[6] = lost;
+    lost = 0;
+    for(n = 0; used > 0 && n < FRAME_RECORDS; n++) {
+      memcpy(&frame[EVLOG_HDR_LEN + n * EVLOG_RECORD_LEN], ring[head],
+             EVLOG_RECORD_LEN);
+      head = (head + 1) % EVLOG_RING;
+      used--;
+    }
+    serial_proto_frame(SERIAL_REC_EVENTS, frame,
+                       EVLOG_HDR_LEN + n * EVLOG_RECORD_LEN);
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,120 @@
+/* evlog.h */
+
+#ifndef EVLOG_H_
+#define EVLOG_H_
+
+#include "contiki.h"
+
+/*
+ * Event log for the hot paths. A log line is an event: an id and up to
+ * three small arguments. In text mode (default) an event is printed at
+ * once as the usual "TREE : ..." / "PROCESS : ..." / "MODE : ..." line.
+ * With EVLOG_CONF_BINARY it is written as an 8-byte record into a RAM
+ * ring instead, and the ring is drained in the background as
+ * SERIAL_REC_EVENTS frames (see serial-proto.h); evlog.py turns those
+ * back into the text lines. Events above EVLOG_LEVEL are compiled out.
+ */
+#define EVLOG_NONE       0
+#define EVLOG_INFO       1   /* state changes: parents, modes, valves */
+#define EVLOG_DEBUG      2   /* per packet and per reading */
+
+#ifdef EVLOG_CONF_LEVEL
+#define EVLOG_LEVEL      EVLOG_CONF_LEVEL
+#else
+#define EVLOG_LEVEL      EVLOG_DEBUG
+#endif
+
+#ifdef EVLOG_CONF_BINARY
+#define EVLOG_BINARY     EVLOG_CONF_BINARY
+#else
+#define EVLOG_BINARY     0
+#endif
+
+/* Records the ring holds; the oldest are lost on overflow */
+#ifdef EVLOG_CONF_RING
+#define EVLOG_RING       EVLOG_CONF_RING
+#else
+#define EVLOG_RING       32
+#endif
+
+/*
+ * How long an event may wait in the ring for a frame to fill up; a full
+ * frame is sent at once. Longer delays save wake-ups.
+ */
+#ifdef EVLOG_CONF_DRAIN_DELAY
+#define EVLOG_DRAIN_DELAY  EVLOG_CONF_DRAIN_DELAY
+#else
+#define EVLOG_DRAIN_DELAY  (CLOCK_SECOND * 4)
+#endif
+
+/*
+ * On the serial line: SERIAL_REC_EVENTS, payload
+ *   now(4, ticks LE), ticks per second(2 LE), lost(1), n * record
+ * record: time(2, low ticks LE), id, a, b(2 LE), c(2 LE)
+ */
+#define EVLOG_HDR_LEN      7
+#define EVLOG_RECORD_LEN   8
+
+/* Event ids and their arguments; evlog.py has the same table */
+enum {
+  EV_HELLO = 1,       /* a battery, b rank, c state */
+  EV_NEW_PARENT,      /* a parent, b rank, c battery */
+  EV_PARENT_MOVED,    /* a parent, b rank */
+  EV_LOST_PARENT,     /* a parent, b EV_LOST_* */
+  EV_REPAIRED,        /* b|c << 16 ms */
+  EV_ROOT,
+  EV_MODE,            /* a power state, b|c << 16 battery in 0.1 % */
+  EV_SEND_READING,    /* a parent, b value */
+  EV_FORWARD,         /* a sensor, b next hop */
+  EV_AGGREGATE,       /* a sensor */
+  EV_SLOPE,           /* a sensor, b|c << 16 slope times SLOPE_SCALE */
+  EV_OPEN_VALVE,      /* a sensor, b next hop */
+  EV_WINDOW_FULL,     /* a sensor, b|c << 16 drops */
+  EV_VALVE_OPEN,
+  EV_VALVE_CLOSED,
+  EV_DEEP_SKIP,
+  EV_CMD_ACKED,       /* a target, b|c << 16 EV_CMD_OUTCOME() */
+  EV_CMD_FAILED,      /* a target, b|c << 16 EV_CMD_OUTCOME() */
+  EV_CMD_SENT,        /* a target, b next hop, c type */
+};
+
+/*
+ * How a command ended: ms until its ack (24 bits), tries and whether the
+ * border router issued it for the server, which it logs as such
+ */
+#define EV_CMD_SERVER           0x80000000UL
+#define EV_CMD_OUTCOME(tries, ms)                                         \
+  (((uint32_t)(ms) & 0xFFFFFFUL) | (uint32_t)((tries) & 0x7F) << 24)
+
+/* Why a parent was dropped */
+enum {
+  EV_LOST_NO_ACK,
+  EV_LOST_NO_HELLO,
+  EV_LOST_POISONED,
+  EV_LOST_RANK_LOOP,
+};
+
+#define EVLOG(level, id, a, b, c)                                         \
+  do {                                                                    \
+    if((level) <= EVLOG_LEVEL) {                                          \
+      evlog_put((id), (a), (b), (c));                                     \
+    }                                                                     \
+  } while(0)
+
+/* An event with a 32-bit argument split over b and c */
+#define EVLOG32(level, id, a, v)                                          \
+  EVLOG(level, id, a, (uint16_t)(uint32_t)(v), (uint16_t)((uint32_t)(v) >> 16))
+
+struct evlog_stats {
+  uint32_t logged;
+  uint32_t lost;        /* overwritten before a drain */
+};
+extern struct evlog_stats evlog_stats;
+
+/* Print or record one event; use EVLOG() so filtered events cost nothing */
+void evlog_put(uint8_t id, uint8_t a, uint16_t b, uint16_t c);
+
+/* Send every recorded event now */
+void evlog_drain(void);
+
+#endif /* EVLOG_H_ */
@@ -0,0 +1,39 @@
+/* proto.h */
+
+#ifndef PROTO_H_
+#define PROTO_H_
+
+#include "trace.h"
+
+/* First byte of every NullNet frame */
+#define MSG_HELLO     1   /* type, rank(2, BE), battery, state, parent,
+                             phase(2, BE), interval */
+#define MSG_READING   2   /* type, node, value(2), seq */
+#define MSG_COMMAND   3   /* type, node, code(2), ttl, origin, seq */
+#define MSG_BATCH     4   /* type, ttl, count, count * record */
+#define MSG_SUMMARY   5   /* type, ttl, count, count * summary */
+#define MSG_PACKED    6   /* a MSG_BATCH bit-packed, see codec.h */
+#define MSG_ACK       7   /* type, origin, node, seq, ttl */
+#define MSG_TELEMETRY 8   /* type, ttl, count, count * report */
+
+#define HELLO_LEN     9
+#define READING_LEN   5
+#define COMMAND_LEN   (7 + TRACE_LEN)
+#define ACK_LEN       5
+
+/* One (id, seq, value) record of a MSG_BATCH frame */
+#define BATCH_HDR_LEN     3
+#define BATCH_RECORD_LEN  (4 + TRACE_LEN)   /* node, seq, value(2), trace */
+
+/* One sensor's epoch of a MSG_SUMMARY frame, see aggregate.h */
+#define SUMMARY_HDR_LEN     3
+#define SUMMARY_RECORD_LEN  12  /* node, origin, epoch, count, min(2),
+                                   max(2), mean(2), slope(2) */
+
+/* One node's report of a MSG_TELEMETRY frame, see telemetry.h */
+#define TELEMETRY_HDR_LEN     3
+#define TELEMETRY_RECORD_LEN  20  /* node, seq, state, battery(2), period(2),
+                                     cpu, lpm, tx, listen (2 each),
+                                     5 * charges */
+
+#endif /* PROTO_H_ */
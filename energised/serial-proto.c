@@ -0,0 +1,174 @@
+/* serial-proto.c */
+
+#include "serial-proto.h"
+#include "proto.h"
+#include "slope-window.h"
+#include "lib/crc16.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RECORD_LEN  4
+
+static uint8_t payload[SERIAL_MAX_PAYLOAD];
+static uint8_t payload_len;
+static uint8_t payload_type;
+
+/*---------------------------------------------------------------------------*/
+static int
+must_escape(uint8_t b)
+{
+  return b == 0x00 || b == '\n' || b == '\r'
+    || b == SERIAL_SYNC || b == SERIAL_ESC;
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_stuffed(uint8_t b)
+{
+  if(must_escape(b)) {
+    putchar(SERIAL_ESC);
+    b ^= 0x20;
+  }
+  putchar(b);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_frame(uint8_t type, const uint8_t *data, uint8_t len)
+{
+  uint8_t hdr[2] = { len, type };
+  uint16_t crc = crc16_data(hdr, sizeof(hdr), 0);
+  crc = crc16_data(data, len, crc);
+
+  putchar(SERIAL_SYNC);
+  put_stuffed(len);
+  put_stuffed(type);
+  for(uint8_t i = 0; i < len; i++) {
+    put_stuffed(data[i]);
+  }
+  put_stuffed(crc & 0xFF);
+  put_stuffed(crc >> 8);
+  putchar('\n');
+}
+/*---------------------------------------------------------------------------*/
+/* Make room for a `len` byte record of `type`, flushing other records */
+static void
+reserve(uint8_t type, uint8_t len)
+{
+  if(payload_len > 0 && (payload_type != type
+                         || payload_len + len > SERIAL_MAX_PAYLOAD)) {
+    serial_proto_flush();
+  }
+  payload_type = type;
+}
+/*---------------------------------------------------------------------------*/
+void
+serial_proto_reading(uint8_t node, uint8_t seq, uint16_t value)
+{
+  if(!SERIAL_PROTO_BINARY) {
+    printf("PROCESS : Server got ID=%u, seq=%u, value=%u\n", node, seq,
+           value);
+    return;
+  }
+  reserve(SERIAL_REC_READINGS, RECORD_LEN);
+  payload[payload_len++] = node;
+  payload[payload_len++] = seq;
+  memcpy(&payload[payload_len], &value, sizeof(value));
+  payload_len += sizeof(value);
+}
+/*---------------------------------------------------------------------------*/
+void
+serial_proto_summary(const struct aggregate_summary *s)
+{
+  if(!SERIAL_PROTO_BINARY) {
+    printf("PROCESS : Server got summary ID=%u, by=%u, epoch=%u, n=%u, "
+           "min=%u, max=%u, mean=%u, slope=" SLOPE_FMT "\n", s->node,
+           s->origin, s->epoch, s->count, s->min, s->max, s->mean,
+           SLOPE_ARGS((int32_t)s->slope));
+    return;
+  }
+  reserve(SERIAL_REC_SUMMARY, SUMMARY_RECORD_LEN);
+  payload[payload_len++] = s->node;
+  payload[payload_len++] = s->origin;
+  payload[payload_len++] = s->epoch;
+  payload[payload_len++] = s->count;
+  memcpy(&payload[payload_len], &s->min, sizeof(s->min));
+  payload_len += sizeof(s->min);
+  memcpy(&payload[payload_len], &s->max, sizeof(s->max));
+  payload_len += sizeof(s->max);
+  memcpy(&payload[payload_len], &s->mean, sizeof(s->mean));
+  payload_len += sizeof(s->mean);
+  memcpy(&payload[payload_len], &s->slope, sizeof(s->slope));
+  payload_len += sizeof(s->slope);
+}
+/*---------------------------------------------------------------------------*/
+void
+serial_proto_telemetry(const struct telemetry_report *r)
+{
+  if(!SERIAL_PROTO_BINARY) {
+    uint16_t bat = r->battery < 0 ? -r->battery : r->battery;
+    printf("ENERGY : Server got report ID=%u, seq=%u, state=%u, "
+           "bat=%s%u.%u%%, t=%u s, cpu=%lu, lpm=%lu, tx=%lu, listen=%lu ms, "
+           "hello=%u, sensor_tx=%u, valve_rx=%u, command_tx=%u, "
+           "forward=%u\n", r->node, r->seq, r->state,
+           r->battery < 0 ? "-" : "", bat / 10, bat % 10, r->period,
+           (unsigned long)telemetry_ms(r, TELEMETRY_CPU),
+           (unsigned long)telemetry_ms(r, TELEMETRY_LPM),
+           (unsigned long)telemetry_ms(r, TELEMETRY_TX),
+           (unsigned long)telemetry_ms(r, TELEMETRY_LISTEN),
+           r->charges[ENERGY_HELLO], r->charges[ENERGY_SENSOR_TX],
+           r->charges[ENERGY_VALVE_RX], r->charges[ENERGY_COMMAND_TX],
+           r->charges[ENERGY_FORWARD]);
+    return;
+  }
+  reserve(SERIAL_REC_TELEMETRY, TELEMETRY_RECORD_LEN);
+  telemetry_pack(&payload[payload_len], r);
+  payload_len += TELEMETRY_RECORD_LEN;
+}
+/*---------------------------------------------------------------------------*/
+void
+serial_proto_flush(void)
+{
+  if(payload_len > 0) {
+    send_frame(payload_type, payload, payload_len);
+    payload_len = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+serial_proto_frame(uint8_t type, const uint8_t *data, uint8_t len)
+{
+  send_frame(type, data, len);
+}
+/*---------------------------------------------------------------------------*/
+int
+serial_proto_decode(const char *line, uint8_t *type, uint8_t *out, int max)
+{
+  uint8_t raw[SERIAL_MAX_PAYLOAD + 4];
+  int n = 0;
+
+  if((uint8_t)*line++ != SERIAL_SYNC) {
+    return -1;
+  }
+  /* unstuff */
+  while(*line != '\0' && n < (int)sizeof(raw)) {
+    uint8_t b = (uint8_t)*line++;
+    if(b == SERIAL_ESC) {
+      if(*line == '\0') {
+        return -1;
+      }
+      b = (uint8_t)*line++ ^ 0x20;
+    }
+    raw[n++] = b;
+  }
+  /* len, type, payload, crc(2) */
+  if(n < 4 || raw[0] != n - 4 || raw[0] > max) {
+    return -1;
+  }
+  uint16_t crc = raw[n - 2] | (raw[n - 1] << 8);
+  if(crc16_data(raw, n - 2, 0) != crc) {
+    return -1;
+  }
+  *type = raw[1];
+  memcpy(out, &raw[2], raw[0]);
+  return raw[0];
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,61 @@
+/* serial-proto.h */
+
+#ifndef SERIAL_PROTO_H_
+#define SERIAL_PROTO_H_
+
+#include "contiki.h"
+#include "aggregate.h"
+#include "telemetry.h"
+
+/*
+ * Border router <-> server link. In text mode (default) readings are
+ * printed as "PROCESS : Server got ..." lines and commands arrive as
+ * "<type> <node> <code>" lines. With SERIAL_PROTO_CONF_BINARY readings
+ * go up in binary frames instead; binary commands are always accepted.
+ *
+ * A binary frame is one serial line:
+ *   SYNC, stuffed(len, type, payload[len], crc16 LE), '\n'
+ * crc16 is Contiki's crc16_data() over len, type and payload. Bytes
+ * 0x00, '\n', '\r', SYNC and ESC are sent as ESC, byte ^ 0x20, so a
+ * frame never breaks the line framing on either side.
+ */
+#ifdef SERIAL_PROTO_CONF_BINARY
+#define SERIAL_PROTO_BINARY  SERIAL_PROTO_CONF_BINARY
+#else
+#define SERIAL_PROTO_BINARY  0
+#endif
+
+#define SERIAL_SYNC          0xA5
+#define SERIAL_ESC           0x7D
+
+/* Record types */
+#define SERIAL_REC_READINGS  1   /* n * (node, seq, value(2)) */
+#define SERIAL_REC_COMMAND   2   /* type, node, code(2) */
+#define SERIAL_REC_SUMMARY   3   /* n * (node, origin, epoch, count, min(2),
+                                         max(2), mean(2), slope(2)) */
+#define SERIAL_REC_EVENTS    4   /* any node's event log, see evlog.h */
+#define SERIAL_REC_TELEMETRY 5   /* n * report, see telemetry.h */
+
+#define SERIAL_MAX_PAYLOAD   64
+
+/* Report one reading to the server (buffered in binary mode) */
+void serial_proto_reading(uint8_t node, uint8_t seq, uint16_t value);
+
+/* Report one sensor's epoch summary (buffered in binary mode) */
+void serial_proto_summary(const struct aggregate_summary *s);
+void serial_proto_telemetry(const struct telemetry_report *r);
+
+/* Send the records buffered so far, one frame per record type */
+void serial_proto_flush(void);
+
+/* Send one frame of `type` right away, from any node */
+void serial_proto_frame(uint8_t type, const uint8_t *data, uint8_t len);
+
+/*
+ * Decode a binary frame received as a serial line. Returns the payload
+ * length and sets *type, or -1 if the line is not a valid frame.
+ */
+int  serial_proto_decode(const char *line, uint8_t *type,
+                         uint8_t *payload, int max);
+
+#endif /* SERIAL_PROTO_H_ */
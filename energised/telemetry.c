@@ -0,0 +1,241 @@
+/* telemetry.c */
+
+#include "telemetry.h"
+#include "proto.h"
+#include "energest.h"
+#include "fwd-queue.h"
+#include "route-table.h"
+#include "lib/random.h"
+#include <string.h>
+
+static const uint8_t activity_type[TELEMETRY_TIMES] = {
+  ENERGEST_TYPE_CPU, ENERGEST_TYPE_LPM,
+  ENERGEST_TYPE_TRANSMIT, ENERGEST_TYPE_LISTEN
+};
+
+static telemetry_report_fn local_fn;
+static struct ctimer  report_timer;
+static struct ctimer  flush_timer;
+static uint8_t        seq;
+static uint8_t        deferred;       /* one came due in DEEP_LPM */
+
+/* What the last report covered up to */
+static uint64_t       last_time[TELEMETRY_TIMES];
+static uint32_t       last_charges[ENERGY_EVENT_COUNT];
+static clock_time_t   last_clock;
+
+/* Our next frame: own report and relayed ones */
+static uint8_t        frame[TELEMETRY_HDR_LEN
+                            + TELEMETRY_MAX_RECORDS * TELEMETRY_RECORD_LEN];
+static uint8_t        count;
+
+/*---------------------------------------------------------------------------*/
+void
+telemetry_pack(uint8_t *rec, const struct telemetry_report *r)
+{
+  uint8_t i;
+
+  rec[0] = r->node;
+  rec[1] = r->seq;
+  rec[2] = r->state;
+  memcpy(&rec[3], &r->battery, sizeof(r->battery));
+  memcpy(&rec[5], &r->period, sizeof(r->period));
+  for(i = 0; i < TELEMETRY_TIMES; i++) {
+    memcpy(&rec[7 + 2 * i], &r->share[i], sizeof(r->share[i]));
+  }
+  memcpy(&rec[15], r->charges, sizeof(r->charges));
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+telemetry_ms(const struct telemetry_report *r, uint8_t i)
+{
+  return ((uint64_t)r->share[i] * r->period * 1000) >> 16;
+}
+/*---------------------------------------------------------------------------*/
+static void
+get_report(const uint8_t *rec, struct telemetry_report *r)
+{
+  uint8_t i;
+
+  r->node = rec[0];
+  r->seq = rec[1];
+  r->state = rec[2];
+  memcpy(&r->battery, &rec[3], sizeof(r->battery));
+  memcpy(&r->period, &rec[5], sizeof(r->period));
+  for(i = 0; i < TELEMETRY_TIMES; i++) {
+    memcpy(&r->share[i], &rec[7 + 2 * i], sizeof(r->share[i]));
+  }
+  memcpy(r->charges, &rec[15], sizeof(r->charges));
+}
+/*---------------------------------------------------------------------------*/
+static void
+flush(void *ptr)
+{
+  ctimer_stop(&flush_timer);
+  if(count > 0) {
+    frame[0] = MSG_TELEMETRY;
+    frame[2] = count;
+    fwd_queue_push(frame, TELEMETRY_HDR_LEN + count * TELEMETRY_RECORD_LEN);
+    count = 0;
+  }
+}
+
+/* Add one report to the next frame; its hop limit is the lowest one */
+static void
+add(const uint8_t *rec, uint8_t ttl)
+{
+  if(count == 0 || ttl < frame[1]) {
+    frame[1] = ttl;
+  }
+  memcpy(&frame[TELEMETRY_HDR_LEN + count * TELEMETRY_RECORD_LEN], rec,
+         TELEMETRY_RECORD_LEN);
+  if(++count == TELEMETRY_MAX_RECORDS) {
+    flush(NULL);
+  } else if(ctimer_expired(&flush_timer)) {
+    ctimer_set(&flush_timer, TELEMETRY_FLUSH_DELAY, flush, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+saturate8(uint32_t v)
+{
+  return v > UINT8_MAX ? UINT8_MAX : v;
+}
+
+/* Activity over the span, in 1/65536 of it */
+static uint16_t
+share(uint64_t ticks, clock_time_t span)
+{
+  uint64_t s;
+
+  if(span == 0) {
+    return 0;
+  }
+  s = (ticks * CLOCK_SECOND << 16) / ((uint64_t)span * ENERGEST_SECOND);
+  return s > UINT16_MAX ? UINT16_MAX : s;
+}
+
+static void
+send_report(void)
+{
+  struct telemetry_report r;
+  uint8_t rec[TELEMETRY_RECORD_LEN];
+  clock_time_t now = clock_time();
+  clock_time_t span = now - last_clock;
+  int32_t tenths;
+  uint8_t i;
+
+  r.node = linkaddr_node_addr.u8[0];
+  r.seq = seq++;
+  r.state = energy_state();
+  tenths = energy_level() / (ENERGY_UNIT / 10);
+  r.battery = (int16_t)MAX(MIN(tenths, INT16_MAX), INT16_MIN);
+  r.period = MIN((span + CLOCK_SECOND / 2) / CLOCK_SECOND, UINT16_MAX);
+  last_clock = now;
+  for(i = 0; i < TELEMETRY_TIMES; i++) {
+    uint64_t t = energest_type_time(activity_type[i]);
+    r.share[i] = share(t - last_time[i], span);
+    last_time[i] = t;
+  }
+  for(i = 0; i < ENERGY_EVENT_COUNT; i++) {
+    r.charges[i] = saturate8(energy_stats.charges[i] - last_charges[i]);
+    last_charges[i] = energy_stats.charges[i];
+  }
+
+  if(local_fn) {
+    local_fn(&r);
+    return;
+  }
+  telemetry_pack(rec, &r);
+  add(rec, FWD_MAX_HOPS);
+}
+
+static void
+report(void *ptr)
+{
+  ctimer_set(&report_timer, TELEMETRY_PERIOD, report, NULL);
+  energy_update();
+  if(energy_state() == POWER_DEEP_LPM) {
+    /* sent on leaving DEEP_LPM, covering the whole span */
+    deferred = 1;
+    return;
+  }
+  send_report();
+}
+/*---------------------------------------------------------------------------*/
+void
+telemetry_init(telemetry_report_fn local)
+{
+  uint32_t first;
+  uint8_t i;
+
+  if(!TELEMETRY_ENABLED) {
+    return;
+  }
+  local_fn = local;
+  count = 0;
+  seq = 0;
+  deferred = 0;
+  for(i = 0; i < TELEMETRY_TIMES; i++) {
+    last_time[i] = energest_type_time(activity_type[i]);
+  }
+  memcpy(last_charges, energy_stats.charges, sizeof(last_charges));
+  last_clock = clock_time();
+  /* nodes booted together report at different times */
+  first = (uint32_t)random_rand() * TELEMETRY_PERIOD / (RANDOM_RAND_MAX + 1);
+  ctimer_set(&report_timer, first + 1, report, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+telemetry_state_changed(void)
+{
+  if(deferred && energy_state() != POWER_DEEP_LPM) {
+    deferred = 0;
+    send_report();
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+telemetry_input(const void *data, uint16_t len, const linkaddr_t *src,
+                telemetry_report_fn fn)
+{
+  const uint8_t *buf = data;
+  const uint8_t *rec;
+  struct telemetry_report r;
+  uint8_t i;
+
+  if(len < TELEMETRY_HDR_LEN || buf[0] != MSG_TELEMETRY
+     || len < TELEMETRY_HDR_LEN + buf[2] * TELEMETRY_RECORD_LEN) {
+    return 0;
+  }
+  rec = &buf[TELEMETRY_HDR_LEN];
+  for(i = 0; i < buf[2]; i++, rec += TELEMETRY_RECORD_LEN) {
+    route_learn(rec[0], src);
+    if(fn) {
+      get_report(rec, &r);
+      fn(&r);
+    }
+  }
+  return buf[2];
+}
+/*---------------------------------------------------------------------------*/
+void
+telemetry_relay(const void *data, uint16_t len)
+{
+  /* a full frame is sent at once, refilling the packetbuf data is in */
+  uint8_t copy[FWD_QUEUE_FRAME_LEN];
+  uint8_t i;
+
+  if(len > sizeof(copy)) {
+    return;
+  }
+  memcpy(copy, data, len);
+  if(copy[1] <= 1) {
+    fwd_queue_stats.ttl_drops++;
+    return;
+  }
+  for(i = 0; i < copy[2]; i++) {
+    add(&copy[TELEMETRY_HDR_LEN + i * TELEMETRY_RECORD_LEN], copy[1] - 1);
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,90 @@
+/* telemetry.h */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+#include "energy.h"
+
+/*
+ * Energy telemetry. Every TELEMETRY_PERIOD a node reports where its
+ * energy went since its last report: the energest time spent in CPU,
+ * LPM, TX and LISTEN, the one-off charges made (HELLOs, upstream frames,
+ * ...), its power state and its battery. Reports go up in MSG_TELEMETRY
+ * frames; relays add the reports they hear to their own next frame
+ * rather than sending one frame per report, and the border router hands
+ * them to the server. A report that comes due in DEEP_LPM is held back
+ * until the node leaves it, and then covers the whole span.
+ */
+#ifdef TELEMETRY_CONF_ENABLED
+#define TELEMETRY_ENABLED      TELEMETRY_CONF_ENABLED
+#else
+#define TELEMETRY_ENABLED      1
+#endif
+
+#ifdef TELEMETRY_CONF_PERIOD
+#define TELEMETRY_PERIOD       TELEMETRY_CONF_PERIOD
+#else
+#define TELEMETRY_PERIOD       (CLOCK_SECOND * 1800)
+#endif
+
+/* Longest a report waits for others to share its frame */
+#ifdef TELEMETRY_CONF_FLUSH_DELAY
+#define TELEMETRY_FLUSH_DELAY  TELEMETRY_CONF_FLUSH_DELAY
+#else
+#define TELEMETRY_FLUSH_DELAY  (CLOCK_SECOND * 60)
+#endif
+
+/* Reports per MSG_TELEMETRY frame, so one fits a forward-queue slot */
+#define TELEMETRY_MAX_RECORDS  3
+
+/* Energest activities reported, in this order */
+enum {
+  TELEMETRY_CPU,
+  TELEMETRY_LPM,
+  TELEMETRY_TX,
+  TELEMETRY_LISTEN,
+  TELEMETRY_TIMES
+};
+
+/* One node's report, as carried on the air and to the server */
+struct telemetry_report {
+  uint8_t  node;
+  uint8_t  seq;
+  uint8_t  state;                         /* enum power_state */
+  int16_t  battery;                       /* 0.1 %, saturated */
+  uint16_t period;                        /* seconds covered */
+  uint16_t share[TELEMETRY_TIMES];        /* of the period, in 1/65536 */
+  uint8_t  charges[ENERGY_EVENT_COUNT];   /* per enum energy_event, saturated */
+};
+
+typedef void (*telemetry_report_fn)(const struct telemetry_report *r);
+
+/*
+ * Start reporting. A node with a parent passes NULL and its reports go
+ * upstream; the border router passes the function handing them on.
+ */
+void    telemetry_init(telemetry_report_fn local);
+
+/* The power state changed: send a report held back in DEEP_LPM */
+void    telemetry_state_changed(void);
+
+/*
+ * Walk a MSG_TELEMETRY frame received from `src` and pass each report to
+ * fn. Every reporting node is learnt as reachable through `src`.
+ * Returns the number of reports, 0 if the frame is not a telemetry frame.
+ */
+uint8_t telemetry_input(const void *data, uint16_t len, const linkaddr_t *src,
+                        telemetry_report_fn fn);
+
+/* Write a report as carried on the air, TELEMETRY_RECORD_LEN bytes */
+void    telemetry_pack(uint8_t *rec, const struct telemetry_report *r);
+
+/* Milliseconds of the report's period spent in activity `i` */
+uint32_t telemetry_ms(const struct telemetry_report *r, uint8_t i);
+
+/* Relay the reports of a MSG_TELEMETRY frame with our next frame */
+void    telemetry_relay(const void *data, uint16_t len);
+
+#endif /* TELEMETRY_H_ */
@@ -0,0 +1,55 @@
+/* trace.c */
+
+#include "trace.h"
+#include "net/linkaddr.h"
+#include <stdio.h>
+
+/*---------------------------------------------------------------------------*/
+static uint16_t
+now_ticks(void)
+{
+  return (uint16_t)(clock_time() / TRACE_TICK);
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_start(struct trace *t, uint8_t state)
+{
+  t->stamp = now_ticks();
+  t->hops = 0;
+  t->state = state;
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+trace_age_ms(const struct trace *t)
+{
+  /* wrapping difference */
+  uint16_t age = now_ticks() - t->stamp;
+
+  return (uint32_t)age * TRACE_TICK * 1000 / CLOCK_SECOND;
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_put(uint8_t *buf, const struct trace *t)
+{
+  buf[0] = t->stamp >> 8;
+  buf[1] = t->stamp;
+  buf[2] = MIN(t->hops, 63) | t->state << 6;
+}
+
+void
+trace_get(const uint8_t *buf, struct trace *t)
+{
+  t->stamp = (buf[0] << 8) | buf[1];
+  t->hops = buf[2] & 63;
+  t->state = buf[2] >> 6;
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_log(const char *stage, uint8_t node, uint8_t seq,
+          const struct trace *t)
+{
+  printf("TRACE : Node %u: %s %u/%u hops=%u state=%u age=%lu ms\n",
+         linkaddr_node_addr.u8[0], stage, node, seq, t->hops, t->state,
+         (unsigned long)trace_age_ms(t));
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,56 @@
+/* trace.h */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "contiki.h"
+
+/*
+ * End-to-end latency tracing. With TRACE_ENABLED every reading record
+ * and every command carries the time its sample was taken at the
+ * origin, the links crossed so far and the origin's power state then.
+ * A command sent because of a reading keeps that reading's stamp, so the
+ * sensor opening its valve sees the age of the whole loop. Each stage
+ * logs what it got as a TRACE line and trace.py turns those into latency
+ * percentiles. Ages assume the motes' clocks agree, as in the simulators.
+ */
+#ifdef TRACE_CONF_ENABLED
+#define TRACE_ENABLED  TRACE_CONF_ENABLED
+#else
+#define TRACE_ENABLED  0
+#endif
+
+/* Bytes appended to a reading record or a command: stamp(2), hops|state */
+#if TRACE_ENABLED
+#define TRACE_LEN      3
+#else
+#define TRACE_LEN      0
+#endif
+
+/* Unit of the stamp; its 16 bits wrap after about 68 minutes */
+#define TRACE_TICK     (CLOCK_SECOND / 16)
+
+struct trace {
+  uint16_t stamp;      /* origin time in TRACE_TICKs */
+  uint8_t  hops;       /* links crossed, at most 63 */
+  uint8_t  state;      /* origin's power state at the stamp */
+};
+
+/* A trace starting here and now */
+void     trace_start(struct trace *t, uint8_t state);
+
+/* Milliseconds since the origin stamp */
+uint32_t trace_age_ms(const struct trace *t);
+
+/* To and from the TRACE_LEN bytes on the air */
+void     trace_put(uint8_t *buf, const struct trace *t);
+void     trace_get(const uint8_t *buf, struct trace *t);
+
+/*
+ * Log a stage: "TRACE : Node <us>: <stage> <node>/<seq> hops=.. state=..
+ * age=.. ms", where node/seq is the reading or the command taken.
+ */
+void     trace_log(const char *stage, uint8_t node, uint8_t seq,
+                   const struct trace *t);
+
+#endif /* TRACE_H_ */
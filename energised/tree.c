@@ -0,0 +1,598 @@
+/* tree.c */
+
+#include "tree.h"
+#include "proto.h"
+#include "energy.h"
+#include "link-cost.h"
+#include "evlog.h"
+#include "lib/trickle-timer.h"
+#include "net/mac/mac.h"
+#include "net/netstack.h"
+#include "net/nullnet/nullnet.h"
+#include "lib/random.h"
+
+/* Longest wait a timer can take, half the clock's range */
+#define TREE_WAIT_MAX     ((clock_time_t)~0 >> 1)
+
+uint16_t     tree_rank = RANK_INFINITE;
+linkaddr_t   tree_parent;
+uint8_t      tree_parent_energy;
+uint8_t      tree_parent_state;
+clock_time_t tree_parent_heard;
+
+/* A neighbour that advertised a lower rank than ours, see TREE_BACKUPS */
+struct backup {
+  linkaddr_t   addr;          /* null when the slot is free */
+  uint16_t     rank;
+  uint8_t      energy;
+  uint8_t      state;
+  uint8_t      interval;      /* its Trickle doublings, see hello_wait */
+  clock_time_t heard;
+};
+
+/* A neighbour below us, see TREE_CHILDREN */
+struct child {
+  linkaddr_t   addr;          /* null when the slot is free */
+  uint8_t      state;
+  clock_time_t heard;
+};
+
+static uint16_t                       parent_rank;  /* as it advertised */
+static uint8_t                        parent_interval;
+static uint8_t                        tx_failures;
+static struct backup                  backups[TREE_BACKUPS];
+static struct child                   children[TREE_CHILDREN];
+static uint16_t                       poisoned_rank;
+static clock_time_t                   poisoned_at;
+static uint16_t                       floor_rank;   /* lowest since joining */
+static clock_time_t                   lost_at;      /* 0: not repairing */
+static struct trickle_timer           hello_tt;
+static uint8_t                        hello_imax;   /* as configured */
+static struct ctimer                  hello_defer, liveness_timer;
+static struct ctimer                  solicit_timer;
+static const struct tree_callbacks   *tree_cb;
+
+static void parent_lost(uint8_t why);
+static uint16_t join_bound(void);
+
+/*---------------------------------------------------------------------------*/
+static uint32_t
+choice_cost(uint16_t rank, uint8_t battery)
+{
+  return rank + (uint32_t)(100 - MIN(battery, 100)) * TREE_ENERGY_WEIGHT;
+}
+/*---------------------------------------------------------------------------*/
+/* Doublings of Imin our Trickle interval is at, for our HELLOs */
+static uint8_t
+hello_interval(void)
+{
+  uint8_t d = 0;
+
+  while(d < hello_imax && (hello_tt.i_min << d) < hello_tt.i_cur) {
+    d++;
+  }
+  return d;
+}
+
+/* How long a neighbour in Trickle interval `interval` may go unheard;
+   tree_init keeps it within TREE_WAIT_MAX */
+static clock_time_t
+hello_wait(uint8_t interval)
+{
+  clock_time_t wait = 0;
+  uint8_t i;
+
+  for(i = 0; i <= TREE_MISSED_HELLOS; i++) {
+    wait += (clock_time_t)TREE_HELLO_IMIN << MIN(interval + i, hello_imax);
+  }
+  return wait;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_hello(void *ptr)
+{
+  uint16_t phase = tree_cb->hello_phase ? tree_cb->hello_phase() : 0;
+  uint8_t buf[HELLO_LEN] = {
+    MSG_HELLO,
+    (uint8_t)(tree_rank >> 8), (uint8_t)tree_rank,
+    tree_cb->battery(),
+    tree_cb->state(),
+    tree_parent.u8[0],
+    (uint8_t)(phase >> 8), (uint8_t)phase,
+    hello_interval()
+  };
+  nullnet_buf = buf;
+  nullnet_len = sizeof(buf);
+  tree_cb->hello_sent();
+  NETSTACK_NETWORK.output(NULL);
+  EVLOG(EVLOG_DEBUG, EV_HELLO, buf[3], tree_rank, buf[4]);
+}
+
+static void
+broadcast_rank(void *ptr, uint8_t suppress)
+{
+  clock_time_t delay;
+
+  if(suppress == TRICKLE_TIMER_TX_SUPPRESS) {
+    return;
+  }
+  delay = tree_cb->hello_delay ? tree_cb->hello_delay() : 0;
+  delay += random_rand() % TREE_HELLO_JITTER;
+  if(delay > 0) {
+    ctimer_set(&hello_defer, delay, send_hello, NULL);
+  } else {
+    send_hello(NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Backup parents */
+static struct backup *
+backup_find(const linkaddr_t *addr)
+{
+  uint8_t i;
+
+  for(i = 0; i < TREE_BACKUPS; i++) {
+    if(linkaddr_cmp(&backups[i].addr, addr)) {
+      return &backups[i];
+    }
+  }
+  return NULL;
+}
+
+static void
+backup_drop(const linkaddr_t *addr)
+{
+  struct backup *b = backup_find(addr);
+
+  if(b != NULL) {
+    linkaddr_copy(&b->addr, &linkaddr_null);
+  }
+}
+
+/* Remember a neighbour above us, replacing a stale or costlier entry */
+static void
+backup_note(const linkaddr_t *addr, uint16_t rank, uint8_t energy,
+            uint8_t state, uint8_t interval, clock_time_t heard)
+{
+  struct backup *b = backup_find(addr);
+  uint32_t cost = choice_cost(link_cost_rank(rank, addr), energy);
+  uint8_t i;
+
+  for(i = 0; b == NULL && i < TREE_BACKUPS; i++) {
+    if(linkaddr_cmp(&backups[i].addr, &linkaddr_null)
+       || clock_time() - backups[i].heard
+          > hello_wait(backups[i].interval)) {
+      b = &backups[i];
+    }
+  }
+  for(i = 0; b == NULL && i < TREE_BACKUPS; i++) {
+    if(choice_cost(link_cost_rank(backups[i].rank, &backups[i].addr),
+                   backups[i].energy) > cost) {
+      b = &backups[i];
+    }
+  }
+  if(b == NULL) {
+    return;
+  }
+  linkaddr_copy(&b->addr, addr);
+  b->rank = rank;
+  b->energy = energy;
+  b->state = state;
+  b->interval = interval;
+  b->heard = heard;
+}
+
+/* Cheapest fresh backup advertising less than `bound` */
+static struct backup *
+backup_best(uint16_t bound)
+{
+  struct backup *best = NULL;
+  uint32_t best_cost = 0;
+  uint8_t i;
+
+  for(i = 0; i < TREE_BACKUPS; i++) {
+    struct backup *b = &backups[i];
+    uint32_t cost;
+    if(linkaddr_cmp(&b->addr, &linkaddr_null) || b->rank >= bound
+       || clock_time() - b->heard > hello_wait(b->interval)) {
+      continue;
+    }
+    cost = choice_cost(link_cost_rank(b->rank, &b->addr), b->energy);
+    if(best == NULL || cost < best_cost) {
+      best = b;
+      best_cost = cost;
+    }
+  }
+  return best;
+}
+
+/* A fresh backup costing about what the parent does takes a share */
+static int
+backup_shares(const struct backup *b)
+{
+  return !linkaddr_cmp(&b->addr, &linkaddr_null)
+         && b->rank < join_bound()
+         && clock_time() - b->heard <= hello_wait(b->interval)
+         && link_cost_rank(b->rank, &b->addr)
+            <= (uint32_t)tree_rank + LINK_COST_HYSTERESIS;
+}
+/*---------------------------------------------------------------------------*/
+/* Children: only their listen windows matter, so least recently heard goes */
+static struct child *
+child_find(const linkaddr_t *addr)
+{
+  uint8_t i;
+
+  for(i = 0; i < TREE_CHILDREN; i++) {
+    if(linkaddr_cmp(&children[i].addr, addr)) {
+      return &children[i];
+    }
+  }
+  return NULL;
+}
+
+static void
+child_note(const linkaddr_t *addr, uint8_t state, clock_time_t heard)
+{
+  struct child *c = child_find(addr);
+  uint8_t i;
+
+  for(i = 0; c == NULL && i < TREE_CHILDREN; i++) {
+    if(linkaddr_cmp(&children[i].addr, &linkaddr_null)) {
+      c = &children[i];
+    }
+  }
+  if(c == NULL) {
+    c = &children[0];
+    for(i = 1; i < TREE_CHILDREN; i++) {
+      if(children[i].heard < c->heard) {
+        c = &children[i];
+      }
+    }
+  }
+  linkaddr_copy(&c->addr, addr);
+  c->state = state;
+  c->heard = heard;
+}
+/*---------------------------------------------------------------------------*/
+static void
+parent_timeout(void *ptr)
+{
+  parent_lost(EV_LOST_NO_HELLO);
+}
+
+/* Until someone adopts us, keep asking the neighbours for HELLOs */
+static void
+solicit(void *ptr)
+{
+  if(tree_rank == RANK_INFINITE) {
+    trickle_timer_reset_event(&hello_tt);
+    ctimer_set(&solicit_timer, TREE_POISON_HOLD, solicit, NULL);
+  }
+}
+
+/* Our rank is about to grow past `old`: hold on to the old bound */
+static void
+rank_rising(uint16_t old)
+{
+  if(old != RANK_INFINITE) {
+    poisoned_rank = old;
+    poisoned_at = clock_time();
+  }
+}
+
+/*
+ * Only neighbours advertising less than this may become our parent. A
+ * descendant may still advertise the rank it had before ours went up, so
+ * the lower bound holds until our new rank has had time to reach it.
+ */
+static uint16_t
+join_bound(void)
+{
+  if(clock_time() - poisoned_at < TREE_POISON_HOLD
+     && poisoned_rank < tree_rank) {
+    return poisoned_rank;
+  }
+  return tree_rank;
+}
+
+static void
+set_parent(const linkaddr_t *addr, uint16_t rank, uint8_t energy,
+           uint8_t state, uint8_t interval, clock_time_t heard)
+{
+  if(!linkaddr_cmp(&tree_parent, &linkaddr_null) && tx_failures == 0) {
+    /* the old parent may still serve as a backup */
+    backup_note(&tree_parent, parent_rank, tree_parent_energy,
+                tree_parent_state, parent_interval, tree_parent_heard);
+  }
+  backup_drop(addr);
+  if(link_cost_rank(rank, addr) > tree_rank) {
+    rank_rising(tree_rank);
+  }
+  tree_rank = link_cost_rank(rank, addr);
+  if(tree_rank < floor_rank) {
+    floor_rank = tree_rank;
+  }
+  parent_rank = rank;
+  linkaddr_copy(&tree_parent, addr);
+  tree_parent_energy = energy;
+  tree_parent_state = state;
+  tree_parent_heard = heard;
+  parent_interval = interval;
+  tx_failures = 0;
+  ctimer_stop(&solicit_timer);
+  ctimer_set(&liveness_timer, hello_wait(interval), parent_timeout, NULL);
+  EVLOG(EVLOG_INFO, EV_NEW_PARENT, addr->u8[0], tree_rank,
+        tree_parent_energy);
+  if(lost_at != 0) {
+    EVLOG32(EVLOG_INFO, EV_REPAIRED, 0,
+            (clock_time() - lost_at) * 1000 / CLOCK_SECOND);
+    lost_at = 0;
+  }
+  trickle_timer_inconsistency(&hello_tt);
+  tree_cb->parent_changed();
+}
+
+/* Local repair: a backup if there is one, else poison and rejoin */
+static void
+parent_lost(uint8_t why)
+{
+  struct backup *b;
+  uint16_t old_rank = tree_rank;
+
+  EVLOG(EVLOG_INFO, EV_LOST_PARENT, tree_parent.u8[0], why, 0);
+  if(lost_at == 0) {
+    lost_at = clock_time();
+    if(lost_at == 0) {
+      lost_at = 1;
+    }
+  }
+  ctimer_stop(&liveness_timer);
+  backup_drop(&tree_parent);
+  linkaddr_copy(&tree_parent, &linkaddr_null);
+
+  b = backup_best(old_rank);
+  if(b != NULL) {
+    struct backup use = *b;
+    set_parent(&use.addr, use.rank, use.energy, use.state, use.interval,
+               use.heard);
+    return;
+  }
+  rank_rising(old_rank);
+  tree_rank = RANK_INFINITE;
+  floor_rank = RANK_INFINITE;
+  solicit(NULL);
+  tree_cb->parent_changed();
+}
+
+/*---------------------------------------------------------------------------*/
+void
+tree_init(const struct tree_callbacks *cb, int root)
+{
+  uint8_t i;
+
+  tree_cb = cb;
+  tree_rank = RANK_INFINITE;
+  tree_parent_energy = 0;
+  poisoned_rank = RANK_INFINITE;
+  floor_rank = RANK_INFINITE;
+  for(i = 0; i < TREE_BACKUPS; i++) {
+    linkaddr_copy(&backups[i].addr, &linkaddr_null);
+  }
+  for(i = 0; i < TREE_CHILDREN; i++) {
+    linkaddr_copy(&children[i].addr, &linkaddr_null);
+  }
+  if(root) {
+    tree_rank = 0;
+    EVLOG(EVLOG_INFO, EV_ROOT, 0, 0, 0);
+  }
+  /* only as many doublings as a timer can wait out TREE_MISSED_HELLOS
+     of: fewer where clock_time_t is 16 bits */
+  hello_imax = TREE_HELLO_IMAX;
+  while(hello_imax > 0
+        && (TREE_WAIT_MAX / (TREE_MISSED_HELLOS + 1) >> hello_imax)
+           < TREE_HELLO_IMIN) {
+    hello_imax--;
+  }
+  if(trickle_timer_config(&hello_tt, TREE_HELLO_IMIN, hello_imax,
+                          TREE_HELLO_K) != TRICKLE_TIMER_SUCCESS) {
+    /* TREE_HELLO_IMIN itself is too long for the clock: no tree */
+    return;
+  }
+  trickle_timer_set(&hello_tt, broadcast_rank, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+tree_reset(void)
+{
+  trickle_timer_reset_event(&hello_tt);
+}
+/*---------------------------------------------------------------------------*/
+const linkaddr_t *
+tree_next_hop(void)
+{
+  uint16_t total, pick;
+  uint8_t i;
+
+  /* duty-cycled, our windows line up with the parent's alone */
+  if(!TREE_LOAD_SHARING || tree_rank == RANK_INFINITE
+     || energy_state() != POWER_ACTIVE) {
+    return &tree_parent;
+  }
+  /* a drained relay still gets the odd frame, so it stays known alive */
+  total = tree_parent_energy + 1;
+  for(i = 0; i < TREE_BACKUPS; i++) {
+    if(backup_shares(&backups[i])) {
+      total += backups[i].energy + 1;
+    }
+  }
+  pick = random_rand() % total;
+  for(i = 0; i < TREE_BACKUPS; i++) {
+    if(backup_shares(&backups[i])) {
+      if(pick <= backups[i].energy) {
+        return &backups[i].addr;
+      }
+      pick -= backups[i].energy + 1;
+    }
+  }
+  return &tree_parent;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+tree_children_state(void)
+{
+  uint8_t i, state = 0;
+
+  for(i = 0; i < TREE_CHILDREN; i++) {
+    if(!linkaddr_cmp(&children[i].addr, &linkaddr_null)) {
+      state = MAX(state, children[i].state);
+    }
+  }
+  return state;
+}
+/*---------------------------------------------------------------------------*/
+int
+tree_neighbour(const linkaddr_t *addr, uint8_t *state, clock_time_t *heard)
+{
+  struct backup *b;
+  struct child *c;
+
+  if(linkaddr_cmp(addr, &tree_parent)) {
+    *state = tree_parent_state;
+    *heard = tree_parent_heard;
+    return 1;
+  }
+  if(linkaddr_cmp(addr, &linkaddr_null)) {
+    return 0;
+  }
+  b = backup_find(addr);
+  if(b != NULL) {
+    *state = b->state;
+    *heard = b->heard;
+    return 1;
+  }
+  c = child_find(addr);
+  if(c != NULL) {
+    *state = c->state;
+    *heard = c->heard;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+tree_link_status(const linkaddr_t *dest, int status, int transmissions)
+{
+  if(!linkaddr_cmp(dest, &tree_parent)) {
+    /* a sharing backup gets no second chance */
+    if(status == MAC_TX_NOACK) {
+      backup_drop(dest);
+    }
+    return;
+  }
+  if(status == MAC_TX_OK) {
+    tx_failures = 0;
+  } else if(status == MAC_TX_NOACK
+            && ++tx_failures >= TREE_MAX_TX_FAILURES) {
+    parent_lost(EV_LOST_NO_ACK);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+tree_input(const void *data, uint16_t len, const linkaddr_t *src)
+{
+  const uint8_t *buf = data;
+  if(len != HELLO_LEN || buf[0] != MSG_HELLO) {
+    return 0;
+  }
+
+  uint16_t recv_rank = (buf[1] << 8) | buf[2];
+  uint8_t  recv_energy = buf[3];
+  uint8_t  recv_state = buf[4];
+  uint8_t  recv_parent = buf[5];
+  uint8_t  recv_interval = buf[8];
+  /* where the cycle of its windows began */
+  clock_time_t began = clock_time() - (clock_time_t)((buf[6] << 8) | buf[7]);
+
+  if(recv_rank != RANK_INFINITE
+     && (recv_parent == linkaddr_node_addr.u8[0] || recv_rank > tree_rank)) {
+    /* below us: commands to it or its subtree may come our way */
+    child_note(src, recv_state, began);
+  }
+
+  if(tree_rank == 0) {
+    if(recv_rank == RANK_INFINITE) {
+      trickle_timer_inconsistency(&hello_tt);
+    } else {
+      trickle_timer_consistency(&hello_tt);
+    }
+    return 1;
+  }
+
+  /* Our parent poisoned its rank: its subtree must move */
+  if(recv_rank == RANK_INFINITE && linkaddr_cmp(src, &tree_parent)) {
+    parent_lost(EV_LOST_POISONED);
+    return 1;
+  }
+
+  /* A neighbour that has not joined yet wants to hear from us soon */
+  if(recv_rank == RANK_INFINITE) {
+    backup_drop(src);
+    if(tree_rank != RANK_INFINITE) {
+      trickle_timer_inconsistency(&hello_tt);
+    }
+    return 1;
+  }
+
+  uint16_t cand_rank = link_cost_rank(recv_rank, src);
+
+  if(linkaddr_cmp(src, &tree_parent)) {
+    /* refresh from the parent; only a real cost change is news */
+    int moved = LINK_COST_BETTER(cand_rank, tree_rank)
+                || LINK_COST_BETTER(tree_rank, cand_rank);
+    if(cand_rank > floor_rank
+       && cand_rank - floor_rank > TREE_MAX_RANK_INCREASE) {
+      /* counting to infinity: leave, bounded by where we joined */
+      tree_rank = floor_rank;
+      parent_lost(EV_LOST_RANK_LOOP);
+      return 1;
+    }
+    parent_rank = recv_rank;
+    tree_parent_energy = recv_energy;
+    tree_parent_state = recv_state;
+    tree_parent_heard = began;
+    parent_interval = recv_interval;
+    if(cand_rank > tree_rank) {
+      rank_rising(tree_rank);
+    }
+    tree_rank = cand_rank;
+    ctimer_set(&liveness_timer, hello_wait(recv_interval), parent_timeout,
+               NULL);
+    if(moved) {
+      EVLOG(EVLOG_INFO, EV_PARENT_MOVED, src->u8[0], tree_rank, 0);
+      trickle_timer_inconsistency(&hello_tt);
+    } else {
+      trickle_timer_consistency(&hello_tt);
+    }
+  } else if(recv_rank < join_bound()    /* never one of our descendants */
+            && recv_parent != linkaddr_node_addr.u8[0]
+            && (tree_rank == RANK_INFINITE
+                || LINK_COST_BETTER(choice_cost(cand_rank, recv_energy),
+                     choice_cost(link_cost_rank(parent_rank, &tree_parent),
+                                 tree_parent_energy)))) {
+    /* cheaper path, counting link quality and the candidate's battery */
+    set_parent(src, recv_rank, recv_energy, recv_state, recv_interval,
+               began);
+  } else {
+    if(recv_rank < tree_rank && recv_parent != linkaddr_node_addr.u8[0]) {
+      backup_note(src, recv_rank, recv_energy, recv_state, recv_interval,
+                  began);
+    } else {
+      backup_drop(src);
+    }
+    /* a sibling or a child agreeing with the current tree */
+    trickle_timer_consistency(&hello_tt);
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
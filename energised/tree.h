@@ -0,0 +1,164 @@
+/* tree.h */
+
+#ifndef TREE_H_
+#define TREE_H_
+
+#include "contiki.h"
+#include "net/linkaddr.h"
+
+#define RANK_INFINITE     0xFFFF
+
+/* Trickle HELLO schedule: Imin, Imax doublings and redundancy constant k */
+#ifdef TREE_CONF_HELLO_IMIN
+#define TREE_HELLO_IMIN      TREE_CONF_HELLO_IMIN
+#else
+#define TREE_HELLO_IMIN      (CLOCK_SECOND * 4)
+#endif
+
+#ifdef TREE_CONF_HELLO_IMAX
+#define TREE_HELLO_IMAX      TREE_CONF_HELLO_IMAX
+#else
+#define TREE_HELLO_IMAX      8          /* 4 s << 8 = ~17 min, see tree_init */
+#endif
+
+/* HELLOs are also what children keep their parent by (see
+   TREE_MISSED_HELLOS), so by default none is suppressed */
+#ifdef TREE_CONF_HELLO_K
+#define TREE_HELLO_K         TREE_CONF_HELLO_K
+#else
+#define TREE_HELLO_K         0          /* infinite redundancy */
+#endif
+
+/* A HELLO goes out up to this long after hello_delay, so that a subtree
+   sharing its parent's windows does not send on one tick */
+#ifdef TREE_CONF_HELLO_JITTER
+#define TREE_HELLO_JITTER    TREE_CONF_HELLO_JITTER
+#else
+#define TREE_HELLO_JITTER    (CLOCK_SECOND / 16)
+#endif
+
+/*
+ * Parent choice adds this cost per battery percent a candidate lacks to
+ * its rank. With the link-cost hysteresis, a parent with 32 points more
+ * battery than the current one over an equally good link wins.
+ */
+#define TREE_ENERGY_WEIGHT     2
+
+/*
+ * Parent liveness. A parent is dropped after TREE_MAX_TX_FAILURES upstream
+ * frames in a row went unacked (each after the MAC's own retries), or
+ * when TREE_MISSED_HELLOS of its HELLOs did not come. A HELLO says which
+ * Trickle interval its sender is in, so the wait is that interval and the
+ * next TREE_MISSED_HELLOS ones, each twice the last up to Imax: a minute
+ * after a reset, about an hour at Imax. Where clock_time_t is 16 bits,
+ * tree_init lowers Imax until a timer can wait that long. Backups go
+ * stale the same way.
+ */
+#ifdef TREE_CONF_MAX_TX_FAILURES
+#define TREE_MAX_TX_FAILURES   TREE_CONF_MAX_TX_FAILURES
+#else
+#define TREE_MAX_TX_FAILURES   3
+#endif
+
+#ifdef TREE_CONF_MISSED_HELLOS
+#define TREE_MISSED_HELLOS     TREE_CONF_MISSED_HELLOS
+#else
+#define TREE_MISSED_HELLOS     3
+#endif
+
+/*
+ * Neighbours above us kept as ready replacements for the parent. Those
+ * whose path costs about as much as the parent's (within the link-cost
+ * hysteresis) also share the upstream load while we are ACTIVE: each
+ * frame goes to one of them or the parent, drawn with odds in proportion
+ * to their battery.
+ */
+#ifdef TREE_CONF_BACKUPS
+#define TREE_BACKUPS           TREE_CONF_BACKUPS
+#else
+#define TREE_BACKUPS           4
+#endif
+
+/*
+ * Neighbours below us whose HELLOs are remembered for when they listen,
+ * so commands going down can wait for their windows.
+ */
+#ifdef TREE_CONF_CHILDREN
+#define TREE_CHILDREN          TREE_CONF_CHILDREN
+#else
+#define TREE_CHILDREN          8
+#endif
+
+#ifdef TREE_CONF_LOAD_SHARING
+#define TREE_LOAD_SHARING      TREE_CONF_LOAD_SHARING
+#else
+#define TREE_LOAD_SHARING      1
+#endif
+
+/*
+ * With no backup left the node poisons its rank, so its subtree lets go
+ * of it, and for TREE_POISON_HOLD only adopts neighbours that were above
+ * its old rank: none of them can be one of its descendants.
+ */
+#define TREE_POISON_HOLD       (TREE_HELLO_IMIN * 2)
+
+/*
+ * A loop that formed anyway shows as ranks counting up through it. A node
+ * whose rank grew by more than this since it joined detaches (in cost
+ * units, see link-cost.h: 16 good hops).
+ */
+#ifdef TREE_CONF_MAX_RANK_INCREASE
+#define TREE_MAX_RANK_INCREASE TREE_CONF_MAX_RANK_INCREASE
+#else
+#define TREE_MAX_RANK_INCREASE 2048
+#endif
+
+/*
+ * Role hooks: what to advertise and what to do on tree events.
+ * hello_delay may hold a due HELLO back until the radio listens again;
+ * NULL sends right away. hello_phase tells how far into the cycle of our
+ * windows a HELLO goes out, so a neighbour knows where that cycle began;
+ * NULL advertises 0.
+ */
+struct tree_callbacks {
+  uint8_t      (*battery)(void);
+  uint8_t      (*state)(void);
+  void         (*hello_sent)(void);
+  void         (*parent_changed)(void);
+  clock_time_t (*hello_delay)(void);
+  clock_time_t (*hello_phase)(void);
+};
+
+extern uint16_t     tree_rank;           /* path cost, see link-cost.h */
+extern linkaddr_t   tree_parent;
+extern uint8_t      tree_parent_energy;
+extern uint8_t      tree_parent_state;   /* power state it advertised */
+extern clock_time_t tree_parent_heard;   /* its window cycle's start */
+
+/*
+ * Every border router starts as a rank-0 root; other nodes join whichever
+ * root is cheapest to reach, so several roots split the network.
+ */
+void tree_init(const struct tree_callbacks *cb, int root);
+
+/* Handle a HELLO frame, returns 1 if the frame was one */
+int  tree_input(const void *data, uint16_t len, const linkaddr_t *src);
+
+/* Something we advertise changed: get it out quickly */
+void tree_reset(void);
+
+/* Where the next upstream frame goes: the parent or a sharing backup */
+const linkaddr_t *tree_next_hop(void);
+
+/* Power state of a parent, backup or child and where the window cycle
+   of its last HELLO began, 0 if unknown */
+int  tree_neighbour(const linkaddr_t *addr, uint8_t *state,
+                    clock_time_t *heard);
+
+/* Highest power state a child advertised, 0 without children */
+uint8_t tree_children_state(void);
+
+/* MAC outcome of an upstream frame, see fwd_queue_set_status() */
+void tree_link_status(const linkaddr_t *dest, int status, int transmissions);
+
+#endif /* TREE_H_ */
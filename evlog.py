@@ -0,0 +1,248 @@
+# evlog.py
+# Turns the binary event frames of a Cooja or sim log back into text.
+#
+# Firmware built with EVLOG_CONF_BINARY=1 keeps its TREE / PROCESS / MODE
+# events in a RAM ring and drains them as SERIAL_REC_EVENTS frames (see
+# energised/evlog.h), one frame per line. Each record is stamped with the
+# low 16 bits of the mote clock and the frame with the full clock, so the
+# time of every event is recovered from the time the line was logged.
+# The events are written out as the lines text-mode firmware prints, in
+# time order among the other lines, so result.py and trace.py read the
+# decoded log as they would a text one:
+#
+#   python3 evlog.py run.txt > run-text.txt
+#   python3 evlog.py --level info run.txt | grep "Node 12:"
+import argparse
+import heapq
+import struct
+import sys
+
+# Serial framing, as in energised/e-server.py
+SYNC = 0xA5
+ESC = 0x7D
+REC_EVENTS = 4
+
+HDR = struct.Struct('<IHB')          # now, ticks per second, lost
+RECORD = struct.Struct('<HBBHH')     # time, id, a, b, c
+
+LEVELS = {"info": 1, "debug": 2}
+
+MODE_NAMES = ["WAKE", "LPM", "DEEP LPM"]
+LOST_NAMES = ["no ack", "no HELLO", "poisoned", "rank loop"]
+
+
+def s32(b, c):
+    v = b | c << 16
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+def slope_text(s):
+    """SLOPE_FMT of a slope times SLOPE_SCALE."""
+    m = abs(s)
+    return "%s%d.%02d" % ("-" if s < 0 else "", m // 1000, m % 1000 // 10)
+
+
+def cmd_text(outcome):
+    """Text of EV_CMD_ACKED / EV_CMD_FAILED, see EV_CMD_OUTCOME()."""
+    def text(n, a, b, c):
+        v = b | c << 16
+        tries = v >> 24 & 0x7F
+        if v & 0x80000000:
+            head = "BORDER: cmd to %d" % a
+        else:
+            head = "PROCESS : Node %d: OPEN_VALVE → %d" % (n, a)
+        if outcome:
+            return "%s acked after %d ms (%d tries)" % (
+                head, v & 0xFFFFFF, tries)
+        return "%s failed (%d tries)" % (head, tries)
+    return text
+
+
+def mode_text(n, a, b, c):
+    bat = s32(b, c)
+    return "MODE : Node %d: %s, battery=%s%d.%d%%" % (
+        n, MODE_NAMES[a] if a < 3 else "?", "-" if bat < 0 else "",
+        abs(bat) // 10, abs(bat) % 10)
+
+
+# Event id -> (level, text of (node, a, b, c)); the table in evlog.h
+EVENTS = {
+    1: (2, lambda n, a, b, c:
+        "TREE : Node %d: HELLO rank=%d bat=%d state=%d" % (n, b, a, c)),
+    2: (1, lambda n, a, b, c:
+        "TREE : Node %d: new parent -> %d (rank=%d, bat=%d)" % (n, a, b, c)),
+    3: (1, lambda n, a, b, c:
+        "TREE : Node %d: parent %d moved, rank=%d" % (n, a, b)),
+    4: (1, lambda n, a, b, c:
+        "TREE : Node %d: lost parent %d (%s)" % (
+            n, a, LOST_NAMES[b] if b < len(LOST_NAMES) else "?")),
+    5: (1, lambda n, a, b, c:
+        "TREE : Node %d: repaired in %d ms" % (n, b | c << 16)),
+    6: (1, lambda n, a, b, c: "TREE : Node %d: I am root (rank 0)" % n),
+    7: (1, mode_text),
+    8: (2, lambda n, a, b, c:
+        "PROCESS : Node %d: send reading %d to %d" % (n, b, a)),
+    9: (2, lambda n, a, b, c:
+        "PROCESS : Node %d: forward sensor %d to %d" % (n, a, b)),
+    10: (2, lambda n, a, b, c:
+         "PROCESS : Node %d: aggregate sensor %d" % (n, a)),
+    11: (2, lambda n, a, b, c:
+         "PROCESS : Node %d: slope=%s sensor=%d" % (
+             n, slope_text(s32(b, c)), a)),
+    12: (1, lambda n, a, b, c:
+         "PROCESS : Node %d: OPEN_VALVE → %d via %d" % (n, a, b)),
+    13: (1, lambda n, a, b, c:
+         "PROCESS : Node %d: window table full, drop sensor %d (drops=%d)"
+         % (n, a, b | c << 16)),
+    14: (1, lambda n, a, b, c: "PROCESS : Node %d: valve OPEN" % n),
+    15: (1, lambda n, a, b, c: "PROCESS : Node %d: valve CLOSED" % n),
+    16: (2, lambda n, a, b, c:
+         "DLPM   : Node %d: in DEEP LPM, skipping sensor send" % n),
+    17: (1, cmd_text(True)),
+    18: (1, cmd_text(False)),
+    19: (1, lambda n, a, b, c:
+         "BORDER: Sent cmd type=%d to %d via %d" % (c, a, b)),
+}
+
+
+def decode_frame(line):
+    """Return (type, payload) of a binary frame, None if invalid."""
+    raw = bytearray()
+    it = iter(line[1:])
+    for b in it:
+        if b == ESC:
+            b = next(it, None)
+            if b is None:
+                return None
+            b ^= 0x20
+        raw.append(b)
+    if len(raw) < 4 or raw[0] != len(raw) - 4:
+        return None
+    acc = 0
+    for b in raw[:-2]:
+        # Contiki's lib/crc16.c (CRC-16/KERMIT)
+        acc ^= b
+        acc = ((acc >> 8) | (acc << 8)) & 0xFFFF
+        acc ^= (acc & 0xFF00) << 4 & 0xFFFF
+        acc ^= (acc >> 8) >> 4
+        acc ^= (acc & 0xFF00) >> 5
+    if acc != struct.unpack_from('<H', raw, len(raw) - 2)[0]:
+        return None
+    return raw[1], bytes(raw[2:-2])
+
+
+def parse_ms(field):
+    """'[h:]mm:ss.mmm' -> milliseconds, None if not a timestamp."""
+    parts = field.split(b":")
+    try:
+        if len(parts) == 2:
+            return int(parts[0]) * 60000 + round(float(parts[1]) * 1000)
+        if len(parts) == 3:
+            return (int(parts[0]) * 3600000 + int(parts[1]) * 60000
+                    + round(float(parts[2]) * 1000))
+    except ValueError:
+        pass
+    return None
+
+
+def format_ms(ms):
+    """Milliseconds -> the timestamp format of the log."""
+    h, ms = divmod(max(ms, 0), 3600000)
+    m, ms = divmod(ms, 60000)
+    if h:
+        return "%d:%02d:%02d.%03d" % (h, m, ms // 1000, ms % 1000)
+    return "%02d:%02d.%03d" % (m, ms // 1000, ms % 1000)
+
+
+def events(ms, node, payload, level, counts):
+    """(ms, text) of every event of one frame, oldest first."""
+    if len(payload) < HDR.size:
+        counts["bad"] += 1
+        return
+    now, tps, lost = HDR.unpack_from(payload)
+    if lost:
+        counts["lost"] += lost
+        yield ms, "EVLOG : Node %d: %d events lost" % (node, lost)
+    for t16, ev, a, b, c in RECORD.iter_unpack(payload[HDR.size:]):
+        age = (now - t16) & 0xFFFF
+        lvl, text = EVENTS.get(ev, (1, None))
+        if lvl > level:
+            continue
+        when = ms - age * 1000 // max(tps, 1)
+        if text is None:
+            counts["unknown"] += 1
+            yield when, "EVLOG : Node %d: event %d a=%d b=%d c=%d" % (
+                node, ev, a, b, c)
+        else:
+            counts["events"] += 1
+            yield when, text(node, a, b, c)
+
+
+def convert(paths, out, level, window):
+    """Decode every log; events are held `window` ms to sort them in."""
+    counts = {"events": 0, "lost": 0, "bad": 0, "unknown": 0}
+    heap = []
+    order = 0
+
+    def emit(upto):
+        while heap and heap[0][0] <= upto:
+            out.write(heapq.heappop(heap)[2])
+
+    for path in paths:
+        f = sys.stdin.buffer if path == "-" else open(path, "rb")
+        last = 0
+        with f:
+            for line in f:
+                parts = line.split(b"\t", 2)
+                ms = parse_ms(parts[0]) if len(parts) == 3 else None
+                if ms is None:
+                    # no time: keep it where it is
+                    heapq.heappush(heap, (last, order, line))
+                    order += 1
+                    continue
+                last = max(last, ms)
+                msg = parts[2].rstrip(b"\r\n")
+                if msg[:1] == bytes([SYNC]) and parts[1].startswith(b"ID:"):
+                    frame = decode_frame(msg)
+                    if frame is None:
+                        counts["bad"] += 1
+                    elif frame[0] == REC_EVENTS:
+                        node = int(parts[1][3:])
+                        for when, text in events(ms, node, frame[1], level,
+                                                 counts):
+                            out_line = b"%s\t%s\t%s\n" % (
+                                format_ms(when).encode(), parts[1],
+                                text.encode())
+                            heapq.heappush(heap, (when, order, out_line))
+                            order += 1
+                        continue
+                heapq.heappush(heap, (ms, order, line))
+                order += 1
+                emit(last - window)
+        emit(last)
+    return counts
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Decode binary event-log frames back into text lines")
+    parser.add_argument("logs", nargs="*", default=["-"],
+                        help="Cooja or sim log files (default: stdin)")
+    parser.add_argument("--level", choices=sorted(LEVELS), default="debug",
+                        help="drop events above this level")
+    parser.add_argument("--window", type=float, default=10.0,
+                        help="seconds an event may lag its frame's line; "
+                             "events older than that are written out of "
+                             "order (default: %(default)s)")
+    args = parser.parse_args()
+
+    counts = convert(args.logs, sys.stdout.buffer, LEVELS[args.level],
+                     int(args.window * 1000))
+    sys.stdout.flush()
+    sys.stderr.write("evlog: %d events, %d lost in the motes, %d bad frames, "
+                     "%d unknown ids\n" % (counts["events"], counts["lost"],
+                                           counts["bad"], counts["unknown"]))
+
+
+if __name__ == "__main__":
+    main()
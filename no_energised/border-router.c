@@ -3,13 +3,14 @@
 #include "dev/serial-line.h"
 #include "net/netstack.h"
 #include "net/nullnet/nullnet.h"
-#include "lib/random.h"
 #include "net/linkaddr.h"
+#include "net/link-stats.h"
+#include "dedup.h"
+#include "route-table.h"
+#include "hello-timer.h"
 #include <stdio.h>
 #include <string.h>
 
-#define HELLO_INTERVAL   (CLOCK_SECOND * 10)
-
 #ifndef BORDER_NODE_ID
 #define BORDER_NODE_ID 1
 #endif
@@ -22,7 +23,6 @@ typedef struct {
 
 static uint16_t      my_rank;
 static linkaddr_t    parent;
-static struct etimer hello_timer;
 
 PROCESS(border_router_process, "Border Router Process");
 AUTOSTART_PROCESSES(&border_router_process);
@@ -43,6 +43,9 @@ static void
 input_callback(const void *data, uint16_t len,
                const linkaddr_t *src, const linkaddr_t *dest)
 {
+  /* NullNet leaves feeding link-stats to us */
+  link_stats_input_callback(src);
+
   /* 1) Tree-ranking messages */
   if(len == sizeof(uint16_t)) {
     uint16_t recv_rank;
@@ -52,14 +55,24 @@ input_callback(const void *data, uint16_t len,
       linkaddr_copy(&parent, src);
       printf("TREE : Node %u: new parent -> %u (rank %u)\n",
              linkaddr_node_addr.u8[0], src->u8[0], my_rank);
+      hello_timer_reset();
+    } else if(recv_rank == 0xFFFF && my_rank != 0xFFFF) {
+      /* an orphan in earshot: beacon soon */
+      hello_timer_reset();
+    } else {
+      hello_timer_consistent();
     }
     return;
   }
 
-  /* 2) Sensor data packets */
-  if(len == sizeof(packet_t)) {
+  /* 2) Sensor data packets, possibly relayed (then seq follows the value) */
+  if(len >= sizeof(packet_t)) {
     const packet_t *pkt = (const packet_t *)data;
+    const uint8_t *buf = data;
     if(pkt->type == 2) {
+      route_learn(pkt->node, src);
+    }
+    if(pkt->type == 2 && (len < 6 || dedup_check(pkt->node, buf[4]))) {
       /* Print to server console via serial */
       printf("PROCESS : Server got ID=%u, value=%u\n", pkt->node, pkt->value);
     }
@@ -75,6 +88,7 @@ PROCESS_THREAD(border_router_process, ev, data)
 
   /* Initialize NullNet input callback */
   nullnet_set_input_callback(input_callback);
+  route_table_init();
 
   /* Set initial rank */
   my_rank = 0xFFFF;
@@ -84,8 +98,8 @@ PROCESS_THREAD(border_router_process, ev, data)
            linkaddr_node_addr.u8[0]);
   }
 
-  /* Start periodic rank broadcasts */
-  etimer_set(&hello_timer, random_rand() % HELLO_INTERVAL);
+  /* Rank broadcasts, on a Trickle schedule */
+  hello_timer_init(broadcast_rank);
 
   while(1) {
     PROCESS_WAIT_EVENT();
@@ -95,24 +109,24 @@ PROCESS_THREAD(border_router_process, ev, data)
       char *line = (char *)data;
       unsigned int type, node, code;
       if(sscanf(line, "%u %u %u", &type, &node, &code) == 3) {
-        uint8_t cmd[4];
+        uint8_t cmd[5];
+        uint16_t code16 = (uint16_t)code;
         cmd[0] = (uint8_t)type;
         cmd[1] = (uint8_t)node;
-        memcpy(&cmd[2], &code, sizeof(uint16_t));
+        memcpy(&cmd[2], &code16, sizeof(code16));
+        cmd[4] = ROUTE_MAX_HOPS;
         nullnet_buf = cmd;
         nullnet_len = sizeof(cmd);
-        linkaddr_t dst = {{ (uint8_t)node }};
-        NETSTACK_NETWORK.output(&dst);
-        printf("BORDER: Sent cmd type=%u to %u (code=%u)\n",
-               type, node, code);
+        /* Down the tree along the route learnt from its readings */
+        linkaddr_t direct = {{ (uint8_t)node }};
+        const linkaddr_t *dst = route_lookup((uint8_t)node);
+        if(dst == NULL) {
+          dst = &direct;
+        }
+        NETSTACK_NETWORK.output(dst);
+        printf("BORDER: Sent cmd type=%u to %u via %u (code=%u)\n",
+               type, node, dst->u8[0], code);
       }
-      continue;
-    }
-
-    /* 2) Periodic tree rank broadcast */
-    if(etimer_expired(&hello_timer)) {
-      broadcast_rank();
-      etimer_reset(&hello_timer);
     }
   }
 
@@ -2,34 +2,24 @@
 #include "contiki.h"
 #include "net/netstack.h"
 #include "net/nullnet/nullnet.h"
-#include "lib/random.h"
 #include "net/linkaddr.h"
+#include "net/link-stats.h"
+#include "sensor-table.h"
+#include "dedup.h"
+#include "route-table.h"
+#include "link-cost.h"
+#include "hello-timer.h"
 #include <stdio.h>
 #include <string.h>
 
-#define HELLO_INTERVAL     (CLOCK_SECOND * 15)
-#define WINDOW_SIZE        30
-#define MAX_SENSORS        5
-#define SLOPE_THRESHOLD    0.5
-#define WINDOW_EXPIRY      (5 * 60)  /* seconds */
+#define SLOPE_THRESHOLD    (SLOPE_SCALE / 2)  /* 0.5 */
 
 #ifndef BORDER_NODE_ID
 #define BORDER_NODE_ID     1
 #endif
 
-/* Per-sensor sliding window */
-typedef struct {
-  uint8_t        id;                     /* sensor address */
-  uint8_t        count;                  /* readings stored */
-  uint8_t        idx;                    /* next write index */
-  clock_time_t   last_ts;                /* timestamp of last reading */
-  uint16_t       values[WINDOW_SIZE];    /* sensor values */
-} sensor_window_t;
-
 static uint16_t      my_rank;
 static linkaddr_t    parent;
-static struct etimer hello_timer;
-static sensor_window_t sensors[MAX_SENSORS];
 
 PROCESS(computation_node_process, "Computation node process");
 AUTOSTART_PROCESSES(&computation_node_process);
@@ -45,108 +35,81 @@ broadcast_rank(void)
          linkaddr_node_addr.u8[0], my_rank);
 }
 
-/* Find or allocate a window slot, expiring old data */
-static sensor_window_t *
-get_window(uint8_t id)
-{
-  int i;
-  /* Expire stale windows */
-  for(i = 0; i < MAX_SENSORS; i++) {
-    if(sensors[i].count > 0
-       && (clock_seconds() - sensors[i].last_ts) > WINDOW_EXPIRY) {
-      memset(&sensors[i], 0, sizeof(sensor_window_t));
-    }
-  }
-  /* Return existing slot */
-  for(i = 0; i < MAX_SENSORS; i++) {
-    if(sensors[i].count > 0 && sensors[i].id == id) {
-      return &sensors[i];
-    }
-  }
-  /* Allocate empty slot */
-  for(i = 0; i < MAX_SENSORS; i++) {
-    if(sensors[i].count == 0) {
-      memset(&sensors[i], 0, sizeof(sensor_window_t));
-      sensors[i].id = id;
-      return &sensors[i];
-    }
-  }
-  return NULL;
-}
-
-/* Compute fixed-interval slope over WINDOW_SIZE values */
-static double
-compute_slope_fixed(sensor_window_t *w)
-{
-  /* we only call when w->count >= WINDOW_SIZE */
-  const double sum_i  = (WINDOW_SIZE - 1) * WINDOW_SIZE / 2.0;
-  const double sum_i2 = (WINDOW_SIZE - 1) * WINDOW_SIZE * (2*WINDOW_SIZE - 1) / 6.0;
-  double sum_v = 0, sum_iv = 0;
-  /* Oldest value is at index w->idx */
-  for(int k = 0; k < WINDOW_SIZE; k++) {
-    int pos = (w->idx + k) % WINDOW_SIZE;
-    double v = (double)w->values[pos];
-    sum_v  += v;
-    sum_iv += k * v;
-  }
-  double num = WINDOW_SIZE * sum_iv - sum_i * sum_v;
-  double den = WINDOW_SIZE * sum_i2 - sum_i * sum_i;
-  return (den != 0) ? (num / den) : 0.0;
-}
-
 /* Handle incoming packets */
 static void
 input_callback(const void *data, uint16_t len,
                const linkaddr_t *src, const linkaddr_t *dest)
 {
+  /* NullNet leaves feeding link-stats to us */
+  link_stats_input_callback(src);
+
   /* 1) Handle rank updates and log them */
   if(len == sizeof(uint16_t)) {
     uint16_t recv_rank;
     memcpy(&recv_rank, data, sizeof(recv_rank));
-    if(recv_rank + 1 < my_rank) {
-      my_rank = recv_rank + 1;
+    uint16_t cand_rank = link_cost_rank(recv_rank, src);
+    uint16_t old_rank = my_rank;
+    if(linkaddr_cmp(src, &parent)) {
+      /* a cheaper path only: with no loop check here, ranks never rise */
+      if(cand_rank < my_rank) {
+        my_rank = cand_rank;
+      }
+    } else if(recv_rank < my_rank && LINK_COST_BETTER(cand_rank, my_rank)) {
+      my_rank = cand_rank;
       linkaddr_copy(&parent, src);
       printf("TREE : Node %u: new parent -> %u (rank %u)\n",
              linkaddr_node_addr.u8[0], src->u8[0], my_rank);
     }
+    /* a new rank, or an orphan in earshot, is news to the neighbours */
+    if(my_rank != old_rank || (recv_rank == 0xFFFF && my_rank != 0xFFFF)) {
+      hello_timer_reset();
+    } else {
+      hello_timer_consistent();
+    }
     return;
   }
 
-  /* 2) Sensor data (type=2,id,value) */
+  /* 2) Sensor data (type=2,id,value[,seq,ttl]) */
   const uint8_t *buf = data;
   if(len >= 4 && buf[0] == 2) {
+    route_learn(buf[1], src);
+    if(len >= 6 && !dedup_check(buf[1], buf[4])) {
+      return;
+    }
     uint8_t sid = buf[1];
     uint16_t val;
     memcpy(&val, buf + 2, sizeof(val));
 
-    sensor_window_t *w = get_window(sid);
+    sensor_window_t *w = sensor_table_get(sid);
     if(w) {
-      w->values[w->idx] = val;
-      w->last_ts        = clock_seconds();
-      if(w->count < WINDOW_SIZE) {
-        w->count++;
-      }
-      w->idx = (w->idx + 1) % WINDOW_SIZE;
+      slope_window_push(&w->win, val);
 
       /* Only compute and print slope once window is full */
-      if(w->count >= WINDOW_SIZE) {
-        double slope = compute_slope_fixed(w);
-        printf("PROCESS : Node %u: slope=%.2f for sensor %u\n",
-               linkaddr_node_addr.u8[0], slope, sid);
+      if(slope_window_full(&w->win)) {
+        int32_t slope = slope_window_slope(&w->win);
+        printf("PROCESS : Node %u: slope=" SLOPE_FMT " for sensor %u\n",
+               linkaddr_node_addr.u8[0], SLOPE_ARGS(slope), sid);
         if(slope > SLOPE_THRESHOLD) {
-          uint8_t cmd[4];
+          uint8_t cmd[5];
           cmd[0] = 3;
           cmd[1] = sid;
           uint16_t code = 1;  // open valve command
           memcpy(&cmd[2], &code, sizeof(code));
+          cmd[4] = ROUTE_MAX_HOPS;
           nullnet_buf = cmd;
           nullnet_len = sizeof(cmd);
-          linkaddr_t dst = {{ sid }};
-          NETSTACK_NETWORK.output(&dst);
+          /* Down the tree along the route learnt from its readings */
+          linkaddr_t direct = {{ sid }};
+          const linkaddr_t *dst = route_lookup(sid);
+          NETSTACK_NETWORK.output(dst ? dst : &direct);
           printf("PROCESS : Node %u: send OPEN_VALVE to %u\n",
                  linkaddr_node_addr.u8[0], sid);
         }
       }
+    } else {
+      printf("PROCESS : Node %u: window table full, drop sensor %u (drops=%lu)\n",
+             linkaddr_node_addr.u8[0], sid,
+             (unsigned long)sensor_table_stats.drops);
     }
     /* Do NOT forward packet upstream to avoid duplicate handling */
   }
@@ -157,6 +120,8 @@ PROCESS_THREAD(computation_node_process, ev, data)
   PROCESS_BEGIN();
 
   nullnet_set_input_callback(input_callback);
+  sensor_table_init();
+  route_table_init();
 
   /* Initialize rank and log if root */
   my_rank = 0xFFFF;
@@ -166,11 +131,9 @@ PROCESS_THREAD(computation_node_process, ev, data)
            linkaddr_node_addr.u8[0]);
   }
 
-  etimer_set(&hello_timer, random_rand() % HELLO_INTERVAL);
+  hello_timer_init(broadcast_rank);
   while(1) {
-    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&hello_timer));
-    broadcast_rank();
-    etimer_reset(&hello_timer);
+    PROCESS_WAIT_EVENT();
   }
 
   PROCESS_END();
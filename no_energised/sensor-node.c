@@ -10,18 +10,24 @@
 #include "net/nullnet/nullnet.h"
 #include "lib/random.h"
 #include "net/linkaddr.h"
+#include "net/link-stats.h"
 #include "dev/leds.h"
+#include "dedup.h"
+#include "fwd-queue.h"
+#include "route-table.h"
+#include "link-cost.h"
+#include "hello-timer.h"
 #include <stdio.h>
 #include <string.h>
-#define HELLO_INTERVAL   (CLOCK_SECOND * 15)
 #define SENSOR_INTERVAL  (CLOCK_SECOND * 60)
 #define VALVE_DURATION   (CLOCK_SECOND * 600)  /* 10 minutes */
 
 static uint16_t my_rank;
 static linkaddr_t parent;
-static struct etimer hello_timer, sensor_timer, valve_timer;
+static struct etimer sensor_timer, valve_timer;
 static bool sensor_timer_started = false;
 static bool valve_open = false;
+static uint8_t reading_seq;
 
 PROCESS(sensor_node_process, "Sensor node process");
 AUTOSTART_PROCESSES(&sensor_node_process);
@@ -39,56 +45,151 @@ typedef struct {
   uint16_t value;
 } packet_t;
 
+/* Sensor reading, relayed hop by hop up to the root */
+typedef struct {
+  uint8_t type;
+  uint8_t node;
+  uint16_t value;
+  uint8_t seq;                 /* per-origin, for duplicate suppression */
+  uint8_t ttl;                 /* hops left */
+} reading_t;
+
+/* Readings start once we joined the tree */
+static void start_readings(void) {
+  if(sensor_timer_started) {
+    return;
+  }
+  PROCESS_CONTEXT_BEGIN(&sensor_node_process);
+  etimer_set(&sensor_timer, SENSOR_INTERVAL);
+  PROCESS_CONTEXT_END(&sensor_node_process);
+  sensor_timer_started = true;
+}
+
+/* Pass a reading up the tree.  The root has no parent to queue it for:
+ * it hands the reading once to whoever is in earshot, as the baseline's
+ * send to the null parent did, rather than filling the queue */
+static void send_reading(const reading_t *r) {
+  if(my_rank == 0) {
+    nullnet_buf = (uint8_t *)r;
+    nullnet_len = sizeof(*r);
+    NETSTACK_NETWORK.output(NULL);
+    return;
+  }
+  fwd_queue_push(r, sizeof(*r));
+}
+
+/* Command frame: type=3, node, value(2), ttl */
+#define COMMAND_LEN 5
+
+static void open_valve(void) {
+  leds_on(LEDS_RED);
+  valve_open = true;
+  PROCESS_CONTEXT_BEGIN(&sensor_node_process);
+  etimer_set(&valve_timer, VALVE_DURATION);
+  PROCESS_CONTEXT_END(&sensor_node_process);
+  printf("PROCESS : Node %u: valve OPEN\n", linkaddr_node_addr.u8[0]);
+}
+
+/* Relay a command one hop down, along the route learnt from its readings */
+static void relay_command(const uint8_t *buf) {
+  uint8_t cmd[COMMAND_LEN];
+  linkaddr_t direct = {{ buf[1] }};
+  const linkaddr_t *nexthop = route_lookup(buf[1]);
+  if(buf[4] <= 1) {
+    return;
+  }
+  memcpy(cmd, buf, COMMAND_LEN);
+  cmd[4]--;
+  nullnet_buf = cmd;
+  nullnet_len = sizeof(cmd);
+  NETSTACK_NETWORK.output(nexthop ? nexthop : &direct);
+  printf("PROCESS : Node %u: relay cmd for %u\n",
+         linkaddr_node_addr.u8[0], buf[1]);
+}
+
 static void input_callback(const void *data, uint16_t len,
                            const linkaddr_t *src, const linkaddr_t *dest) {
+  /* NullNet leaves feeding link-stats to us */
+  link_stats_input_callback(src);
   if(len == sizeof(uint16_t)) {
     uint16_t recv_rank;
     memcpy(&recv_rank, data, sizeof(recv_rank));
-    if(recv_rank + 1 < my_rank) {
-      my_rank = recv_rank + 1;
+    uint16_t cand_rank = link_cost_rank(recv_rank, src);
+    uint16_t old_rank = my_rank;
+    if(linkaddr_cmp(src, &parent)) {
+      /* a cheaper path only: with no loop check here, ranks never rise */
+      if(cand_rank < my_rank) {
+        my_rank = cand_rank;
+      }
+    } else if(recv_rank < my_rank && LINK_COST_BETTER(cand_rank, my_rank)) {
+      my_rank = cand_rank;
       linkaddr_copy(&parent, src);
       printf("TREE : Node %u: new parent -> %u (rank %u)\n",
              linkaddr_node_addr.u8[0], src->u8[0], my_rank);
+      fwd_queue_kick();
+      start_readings();
+    }
+    /* a new rank, or an orphan in earshot, is news to the neighbours */
+    if(my_rank != old_rank || (recv_rank == 0xFFFF && my_rank != 0xFFFF)) {
+      hello_timer_reset();
+    } else {
+      hello_timer_consistent();
     }
-  } else if(len == sizeof(packet_t)) {
+  } else if(len == sizeof(packet_t) || len == COMMAND_LEN) {
     const packet_t *pkt = (const packet_t *)data;
-    if(pkt->type == 3 && pkt->value == 1) {
-      leds_on(LEDS_RED);
-      valve_open = true;
-      etimer_set(&valve_timer, VALVE_DURATION);
-      printf("PROCESS : Node %u: valve OPEN\n", linkaddr_node_addr.u8[0]);
+    if(pkt->type != 3) {
+      return;
     }
+    if(pkt->node == linkaddr_node_addr.u8[0] || len == sizeof(packet_t)) {
+      if(pkt->value == 1) {
+        open_valve();
+      }
+    } else {
+      relay_command(data);
+    }
+  } else if(len == sizeof(reading_t)) {
+    /* A child's reading: relay it to our parent */
+    reading_t r;
+    memcpy(&r, data, sizeof(r));
+    if(r.type != 2) {
+      return;
+    }
+    route_learn(r.node, src);
+    if(!dedup_check(r.node, r.seq)) {
+      return;
+    }
+    if(r.ttl <= 1) {
+      fwd_queue_stats.ttl_drops++;
+      return;
+    }
+    r.ttl--;
+    send_reading(&r);
+    printf("PROCESS : Node %u: forward sensor %u to %u\n",
+           linkaddr_node_addr.u8[0], r.node, parent.u8[0]);
   }
 }
 
 PROCESS_THREAD(sensor_node_process, ev, data) {
   PROCESS_BEGIN();
   nullnet_set_input_callback(input_callback);
+  fwd_queue_init(&parent, NULL);
+  route_table_init();
   my_rank = 0xFFFF;
   /* Always root if this is the border node */
   if(linkaddr_node_addr.u8[0] == BORDER_NODE_ID) {
     my_rank = 0;
     printf("TREE : Node %u: I am root (rank 0)\n", linkaddr_node_addr.u8[0]);
+    start_readings();
   }
-  etimer_set(&hello_timer, random_rand() % HELLO_INTERVAL);
+  hello_timer_init(broadcast_rank);
 
   while(1) {
     PROCESS_WAIT_EVENT();
-    if(etimer_expired(&hello_timer)) {
-      broadcast_rank();
-      etimer_reset(&hello_timer);
-      /* Start sensor readings once tree is formed */
-      if(!sensor_timer_started && my_rank != 0xFFFF) {
-        etimer_set(&sensor_timer, SENSOR_INTERVAL);
-        sensor_timer_started = true;
-      }
-    }
     if(sensor_timer_started && etimer_expired(&sensor_timer)) {
       uint16_t reading = random_rand() % 100;
-      packet_t pkt = {2, linkaddr_node_addr.u8[0], reading};
-      nullnet_buf = (uint8_t *)&pkt;
-      nullnet_len = sizeof(pkt);
-      NETSTACK_NETWORK.output(&parent);
+      reading_t r = {2, linkaddr_node_addr.u8[0], reading,
+                     reading_seq++, FWD_MAX_HOPS};
+      send_reading(&r);
       printf("PROCESS : Node %u: send reading %u to %u\n",
              linkaddr_node_addr.u8[0], reading, parent.u8[0]);
       etimer_reset(&sensor_timer);
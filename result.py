@@ -1,67 +1,293 @@
-# Open a txt file and retrieve data from it
-file = open("energised/result.txt", "r")
-
-# with the following line format : 1:46:39.448	ID:5	TREE : Node 5: broadcast rank 1
-# Keep only value with time <= 1:30:00:000
-
-# Read the file line by line
-lines = file.readlines()
-# Create a list to store the filtered lines
-filtered_lines = []
-# Iterate through each line in the file
-for line in lines:
-    # Split the line into parts
-    parts = line.split("\t")
-    # Check if the line has the expected number of parts
-    if len(parts) >= 3:
-        # Extract the time part and convert it to seconds
-        time_part = parts[0]
-        time_parts = time_part.split(":")
-        if len(time_parts) == 3:
-            hours = int(time_parts[0])
-            minutes = int(time_parts[1])
-            seconds = float(time_parts[2])
-            total_seconds = hours * 3600 + minutes * 60 + seconds
-            # Check if the total seconds is less than or equal to 5400 (1 hour 30 minutes)
-            if total_seconds <= 7200:
-                filtered_lines.append(line.strip())
-# count the lines having "send reading" inside 
-countsd = 0
-counthello = 0
-countV = 0
-countV2 = 0
-countS = 0
-countL =0
-for line in filtered_lines:
-    if "send reading" in line:
-        countsd += 1
-    if "HELLO" in line:
-        counthello += 1
-    if "valve" in line:
-        countV += 1
-    if "Server got" in line:
-        countS += 1
-    countL += 1
-# Print the counts
-print("Count of 'send reading':", countsd)
-print("Count of 'HELLO':", counthello)
-print("Count of 'valve':", countV)
-print("Count of 'Server got':", countS)
-print("Count of all lines:", countL)
-# Close the file
-file.close()
-
-#energyised
-# Count of 'send reading': 208
-# Count of 'HELLO': 5078
-# Count of 'valve': 35
-# Count of 'Server got': 70
-# Count of all lines: 5737
-
-
-#unenergised
-# Count of 'send reading': 300
-# Count of 'HELLO': 2776
-# Count of 'valve': 30
-# Count of 'Server got': 60
-# Count of all lines: 5769
\ No newline at end of file
+# result.py
+# Single-pass analyser for Cooja mote-output logs.
+#
+# Each line looks like "1:46:39.448\tID:5\tTREE : Node 5: ..." (the hour
+# field is absent for the first hour). Files are streamed line by line,
+# so memory use only grows with the number of nodes, and several files
+# are analysed in parallel, one worker process per file.
+#
+#   python3 result.py energised/result.txt no_energised/result.txt
+#   python3 result.py --until 7200 --format csv run-*.txt > summary.csv
+import argparse
+import csv
+import json
+import os
+import re
+import sys
+from collections import defaultdict
+from multiprocessing import Pool
+
+DEFAULT_LOGS = ["energised/result.txt"]
+
+# Message patterns, matched against the text after "ID:n\t"
+SERVER_GOT_RE = re.compile(rb"Server got ID=(\d+)(?:, seq=(\d+))?")
+REPORT_RE = re.compile(rb"Server got report ID=(\d+), seq=(\d+)")
+SUMMARY_RE = re.compile(rb"Server got summary ID=(\d+), "
+                        rb"(?:by=(\d+), epoch=(\d+), )?n=(\d+)")
+SEND_READING_RE = re.compile(rb"send reading \d+ to (\d+)")
+FORWARD_RE = re.compile(rb"forward sensor (\d+)")
+NEW_PARENT_RE = re.compile(rb"new parent -> (\d+)")
+MODE_RE = re.compile(rb"MODE : Node \d+: (WAKE|LPM|DEEP LPM)")
+REPAIRED_RE = re.compile(rb"repaired in (\d+) ms")
+CMD_ACKED_RE = re.compile(rb"acked after (\d+) ms")
+# A beacon, not "lost parent p (no HELLO)": energised and no_energised
+HELLO_RE = re.compile(rb": HELLO rank=|broadcast rank")
+
+# A (node, seq) pair heard again within this many seconds, through another
+# border router, is a duplicate (seq is one byte, as in e-server.py)
+DUP_WINDOW = 600
+
+# Per-node counters, in output column order
+FIELDS = [
+    "readings_sent",       # own readings handed to the parent
+    "readings_delivered",  # "Server got" lines for this origin
+    "duplicates",          # the same reading delivered again
+    "pdr",                 # delivered / sent
+    "forwarded",           # children's readings relayed
+    "aggregated",          # readings folded into epoch summaries
+    "skipped_deep_lpm",    # sensor periods skipped in deep LPM
+    "hellos",              # HELLO beacons sent
+    "hello_rate",          # HELLOs per minute of observed time
+    "valve_open",          # valve actuations
+    "open_valve_sent",     # OPEN_VALVE commands issued
+    "cmd_acked",           # commands issued here and acked by their target
+    "cmd_failed",          # commands given up on after every retry
+    "cmd_latency_max_s",   # longest time from issuing a command to its ack
+    "reports_delivered",   # energy reports of this node the server got
+    "reports_expected",    # its highest report seq + 1: gaps are losses
+    "report_ratio",        # delivered / expected
+    "window_drops",        # readings dropped for a full window table
+    "state_changes",       # power-state transitions
+    "parent_changes",      # parent churn
+    "parent_losses",       # parents dropped as dead or poisoned
+    "repair_max_s",        # longest time from a loss to a new parent
+    "deep_lpm_s",          # time spent run down in DEEP LPM
+    "last_state",
+    "last_parent",
+]
+
+
+def parse_time(field):
+    """'[h:]mm:ss.mmm' -> seconds, None if the field is not a timestamp."""
+    parts = field.split(b":")
+    try:
+        if len(parts) == 2:
+            return int(parts[0]) * 60 + float(parts[1])
+        if len(parts) == 3:
+            return int(parts[0]) * 3600 + int(parts[1]) * 60 + float(parts[2])
+    except ValueError:
+        pass
+    return None
+
+
+def new_node():
+    return {
+        "readings_sent": 0, "readings_delivered": 0, "duplicates": 0,
+        "forwarded": 0, "aggregated": 0,
+        "skipped_deep_lpm": 0, "hellos": 0, "valve_open": 0,
+        "open_valve_sent": 0, "cmd_acked": 0, "cmd_failed": 0,
+        "cmd_latency_max_s": None, "reports_delivered": 0,
+        "reports_expected": 0, "window_drops": 0, "state_changes": 0,
+        "parent_changes": 0, "parent_losses": 0, "repair_max_s": None,
+        "deep_lpm_s": 0.0, "deep_lpm_since": None,
+        "last_state": None, "last_parent": None,
+    }
+
+
+def analyse(path, until=None):
+    """Stream one log file and return its summary dict."""
+    nodes = defaultdict(new_node)
+    seen = {}                  # (node, seq) -> last delivery time
+                               # ... and (node, by, epoch) of summaries
+    reports = set()            # (node, seq) of energy reports
+    lines = 0
+    first = last = None
+
+    with open(path, "rb") as f:
+        for line in f:
+            parts = line.split(b"\t", 2)
+            if len(parts) < 3 or not parts[1].startswith(b"ID:"):
+                continue
+            t = parse_time(parts[0])
+            if t is None:
+                continue
+            if until is not None and t > until:
+                # Cooja writes lines in simulated-time order
+                break
+            lines += 1
+            if first is None:
+                first = t
+            last = t
+            msg = parts[2]
+            node = nodes[int(parts[1][3:])]
+
+            if HELLO_RE.search(msg):
+                node["hellos"] += 1
+            elif b"acked after" in msg:
+                # computation node or border router, on the ack's arrival
+                m = CMD_ACKED_RE.search(msg)
+                if m:
+                    s = int(m.group(1)) / 1000
+                    node["cmd_acked"] += 1
+                    node["cmd_latency_max_s"] = max(
+                        node["cmd_latency_max_s"] or 0, s)
+            elif b"tries)" in msg:
+                node["cmd_failed"] += 1
+            elif msg.startswith(b"PROCESS"):
+                if b"Server got summary" in msg:
+                    # one line stands for n readings of that sensor
+                    m = SUMMARY_RE.search(msg)
+                    if m:
+                        origin = nodes[int(m.group(1))]
+                        key = m.group(1, 2, 3)
+                        if (m.group(3) is not None
+                                and t - seen.get(key, -DUP_WINDOW)
+                                < DUP_WINDOW):
+                            origin["duplicates"] += int(m.group(4))
+                        else:
+                            origin["readings_delivered"] += int(m.group(4))
+                        seen[key] = t
+                elif b"Server got" in msg:
+                    m = SERVER_GOT_RE.search(msg)
+                    if m:
+                        origin = nodes[int(m.group(1))]
+                        key = (m.group(1), m.group(2))
+                        if (m.group(2) is not None
+                                and t - seen.get(key, -DUP_WINDOW)
+                                < DUP_WINDOW):
+                            origin["duplicates"] += 1
+                        else:
+                            origin["readings_delivered"] += 1
+                        seen[key] = t
+                elif b"send reading" in msg:
+                    node["readings_sent"] += 1
+                elif b"forward sensor" in msg:
+                    node["forwarded"] += 1
+                elif b"aggregate sensor" in msg:
+                    node["aggregated"] += 1
+                elif b"valve OPEN" in msg:
+                    node["valve_open"] += 1
+                elif b"OPEN_VALVE" in msg:
+                    node["open_valve_sent"] += 1
+                elif b"window table full" in msg:
+                    node["window_drops"] += 1
+            elif msg.startswith(b"MODE"):
+                m = MODE_RE.match(msg)
+                if m:
+                    state = m.group(1).decode()
+                    if node["last_state"] not in (None, state):
+                        node["state_changes"] += 1
+                    if node["deep_lpm_since"] is not None:
+                        node["deep_lpm_s"] += t - node["deep_lpm_since"]
+                        node["deep_lpm_since"] = None
+                    if state == "DEEP LPM":
+                        node["deep_lpm_since"] = t
+                    node["last_state"] = state
+            elif msg.startswith(b"TREE"):
+                if b"lost parent" in msg:
+                    node["parent_losses"] += 1
+                    continue
+                m = REPAIRED_RE.search(msg)
+                if m:
+                    s = int(m.group(1)) / 1000
+                    node["repair_max_s"] = max(node["repair_max_s"] or 0, s)
+                    continue
+                m = NEW_PARENT_RE.search(msg)
+                if m:
+                    parent = int(m.group(1))
+                    if node["last_parent"] is not None:
+                        node["parent_changes"] += 1
+                    node["last_parent"] = parent
+            elif msg.startswith(b"DLPM"):
+                node["skipped_deep_lpm"] += 1
+            elif msg.startswith(b"ENERGY"):
+                m = REPORT_RE.search(msg)
+                if m and m.group(1, 2) not in reports:
+                    # seq is one byte: good for 5 days at one per 30 min
+                    reports.add(m.group(1, 2))
+                    origin = nodes[int(m.group(1))]
+                    origin["reports_delivered"] += 1
+                    origin["reports_expected"] = max(
+                        origin["reports_expected"], int(m.group(2)) + 1)
+
+    duration = (last - first) if lines else 0.0
+    minutes = duration / 60 if duration > 0 else None
+    totals = defaultdict(int)
+    for n in nodes.values():
+        n["report_ratio"] = (round(n["reports_delivered"] /
+                                   n["reports_expected"], 4)
+                             if n["reports_expected"] else None)
+        if n["deep_lpm_since"] is not None:
+            n["deep_lpm_s"] += last - n["deep_lpm_since"]
+        n["deep_lpm_s"] = round(n["deep_lpm_s"], 3)
+        n["pdr"] = (round(n["readings_delivered"] / n["readings_sent"], 4)
+                    if n["readings_sent"] else None)
+        n["hello_rate"] = (round(n["hellos"] / minutes, 3)
+                           if minutes else None)
+        for k, v in n.items():
+            if isinstance(v, int) and not k.startswith("last_"):
+                totals[k] += v
+    repairs = [n["repair_max_s"] for n in nodes.values()
+               if n["repair_max_s"] is not None]
+    totals["repair_max_s"] = max(repairs) if repairs else None
+    latencies = [n["cmd_latency_max_s"] for n in nodes.values()
+                 if n["cmd_latency_max_s"] is not None]
+    totals["cmd_latency_max_s"] = max(latencies) if latencies else None
+    totals["deep_lpm_s"] = round(sum(n["deep_lpm_s"]
+                                     for n in nodes.values()), 3)
+    totals["pdr"] = (round(totals["readings_delivered"] /
+                           totals["readings_sent"], 4)
+                     if totals["readings_sent"] else None)
+    totals["report_ratio"] = (round(totals["reports_delivered"] /
+                                    totals["reports_expected"], 4)
+                              if totals["reports_expected"] else None)
+
+    return {
+        "file": path,
+        "lines": lines,
+        "start": first,
+        "end": last,
+        "nodes": {str(k): {f: nodes[k][f] for f in FIELDS}
+                  for k in sorted(nodes)},
+        "totals": dict(totals),
+    }
+
+
+def write_csv(results, out):
+    w = csv.writer(out)
+    w.writerow(["file", "node"] + FIELDS)
+    for r in results:
+        for node_id, n in r["nodes"].items():
+            w.writerow([r["file"], node_id] + [n[f] for f in FIELDS])
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Summarise Cooja logs per node (PDR, HELLOs, valves, "
+                    "power states, parent churn)")
+    parser.add_argument("logs", nargs="*", default=DEFAULT_LOGS,
+                        help="Cooja log files (default: %(default)s)")
+    parser.add_argument("--until", type=float, default=None,
+                        help="ignore lines after this many simulated seconds")
+    parser.add_argument("--format", choices=("json", "csv"), default="json")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count(),
+                        help="worker processes (default: one per core)")
+    args = parser.parse_args()
+
+    jobs = max(1, min(args.jobs or 1, len(args.logs)))
+    work = [(path, args.until) for path in args.logs]
+    if jobs == 1:
+        results = [analyse(*w) for w in work]
+    else:
+        with Pool(jobs) as pool:
+            results = pool.starmap(analyse, work)
+
+    if args.format == "csv":
+        write_csv(results, sys.stdout)
+    else:
+        json.dump(results, sys.stdout, indent=1)
+        sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
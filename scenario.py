@@ -0,0 +1,445 @@
+# scenario.py
+# Generate Cooja scenarios and run seed/parameter sweeps headless.
+#
+# Topologies are grid, random, line and cluster, with one border router
+# (or --roots of them) per field and a mix of computation and sensor
+# nodes. Node IDs are one
+# byte on the air, so larger scenarios are split into independent fields
+# of at most 254 motes, one .csc file each, and summed per run.
+#
+#   python3 scenario.py gen --topology cluster --motes 120 -o big.csc
+#   python3 scenario.py sweep --topology grid,random --motes 50,100,250,500 \
+#       --seeds 5 --duration 3600 > sweep.csv
+#
+# Sweeps run one scenario per core. The default backend is the host
+# simulator in sim/; --backend cooja runs each file with
+# "$COOJA --no-gui" and reads back the ScriptRunner test log.
+import argparse
+import csv
+import glob
+import itertools
+import math
+import os
+import random
+import shlex
+import subprocess
+import sys
+import time
+from multiprocessing import Pool
+from xml.sax.saxutils import escape
+
+from result import analyse
+
+ROOT = os.path.dirname(os.path.abspath(__file__))
+MAX_FIELD_MOTES = 254
+TOPOLOGIES = ("grid", "random", "line", "cluster")
+
+SOURCES = {
+    "energised": {"border": "e-border-router", "computation":
+                  "e-computation-node", "sensor": "e-sensor-node"},
+    "no_energised": {"border": "border-router", "computation":
+                     "computation-node", "sensor": "sensor-node"},
+}
+DESCRIPTIONS = {"border": "Border", "computation": "Compute",
+                "sensor": "Sensor"}
+
+MOTE_INTERFACES = [
+    "org.contikios.cooja.interfaces.Position",
+    "org.contikios.cooja.interfaces.Battery",
+    "org.contikios.cooja.contikimote.interfaces.ContikiVib",
+    "org.contikios.cooja.contikimote.interfaces.ContikiMoteID",
+    "org.contikios.cooja.contikimote.interfaces.ContikiRS232",
+    "org.contikios.cooja.contikimote.interfaces.ContikiBeeper",
+    "org.contikios.cooja.interfaces.IPAddress",
+    "org.contikios.cooja.contikimote.interfaces.ContikiRadio",
+    "org.contikios.cooja.contikimote.interfaces.ContikiButton",
+    "org.contikios.cooja.contikimote.interfaces.ContikiPIR",
+    "org.contikios.cooja.contikimote.interfaces.ContikiClock",
+    "org.contikios.cooja.contikimote.interfaces.ContikiLED",
+    "org.contikios.cooja.contikimote.interfaces.ContikiCFS",
+    "org.contikios.cooja.contikimote.interfaces.ContikiEEPROM",
+    "org.contikios.cooja.interfaces.Mote2MoteRelations",
+    "org.contikios.cooja.interfaces.MoteAttributes",
+]
+
+# Prints every mote line in the same format as the LogListener, then
+# stops the simulation after TIMEOUT ms
+LOG_SCRIPT = """TIMEOUT(%d, log.testOK());
+function stamp(us) {
+  var ms = Math.floor(us / 1000), s = Math.floor(ms / 1000);
+  var m = Math.floor(s / 60), h = Math.floor(m / 60);
+  function pad(v, n) { v = "" + v; while(v.length < n) v = "0" + v; return v; }
+  return (h > 0 ? h + ":" : "") + pad(m %% 60, 2) + ":" + pad(s %% 60, 2) +
+         "." + pad(ms %% 1000, 3);
+}
+while(true) {
+  log.log(stamp(time) + "\\tID:" + id + "\\t" + msg + "\\n");
+  YIELD();
+}
+"""
+
+# Per-run columns of the sweep table
+RUN_FIELDS = [
+    "topology", "motes", "fields", "roots", "range", "success", "seed",
+    "lines", "readings_sent", "readings_delivered", "duplicates", "pdr",
+    "forwarded", "aggregated", "skipped_deep_lpm", "hellos", "hello_rate",
+    "joined", "parent_changes", "parent_losses", "repair_max_s", "deep_lpm_s",
+    "state_changes", "window_drops", "valve_open", "cmd_acked", "cmd_failed",
+    "cmd_latency_max_s", "wall_s",
+]
+
+
+# -- Topologies --------------------------------------------------------------
+
+def roles_for(n, computation, roots=1):
+    """Borders first, then computation nodes, then sensors (IDs in order)."""
+    roots = max(1, min(roots, n - 1))
+    n_comp = max(1, round((n - roots) * computation)) if n > 2 else 0
+    return ["border"] * roots + ["computation"] * n_comp + \
+           ["sensor"] * (n - roots - n_comp)
+
+
+def place(topology, roles, rng, tx_range):
+    """One (x, y) per mote. The border router sits in the middle, or at
+    the end of a line, so hop counts grow with the field. Several border
+    routers are spread out instead, see spread_roots()."""
+    pos = place_one_root(topology, roles, rng, tx_range)
+    roots = roles.count("border")
+    if roots > 1:
+        spread_roots(topology, pos, roots, tx_range)
+    return pos
+
+
+def spread_roots(topology, pos, roots, tx_range):
+    """Move border k to the mote nearest the k-th anchor: evenly along a
+    line, else on a ring around the middle of the field. The mote there
+    takes the border's old place."""
+    n = len(pos)
+    if topology == "line":
+        step = 0.8 * tx_range
+        anchors = [(round(k * (n - 1) / (roots - 1)) * step, 0.0)
+                   for k in range(roots)]
+    else:
+        xs = [p[0] for p in pos]
+        ys = [p[1] for p in pos]
+        cx, cy = (min(xs) + max(xs)) / 2, (min(ys) + max(ys)) / 2
+        r = (max(xs) - min(xs) + max(ys) - min(ys)) / 8
+        anchors = [(cx + r * math.cos(2 * math.pi * k / roots),
+                    cy + r * math.sin(2 * math.pi * k / roots))
+                   for k in range(roots)]
+    for k, (ax, ay) in enumerate(anchors):
+        j = min(range(k, n),
+                key=lambda i: math.hypot(pos[i][0] - ax, pos[i][1] - ay))
+        pos[k], pos[j] = pos[j], pos[k]
+
+
+def place_one_root(topology, roles, rng, tx_range):
+    n = len(roles)
+    if topology == "line":
+        step = 0.8 * tx_range
+        return [(i * step, rng.uniform(-0.1, 0.1) * step) for i in range(n)]
+
+    # about eight neighbours per mote, as in sim/sim.c
+    side = math.sqrt(n * math.pi * tx_range * tx_range / 8.0)
+    centre = (side / 2, side / 2)
+
+    if topology == "grid":
+        cols = math.ceil(math.sqrt(n))
+        step = 0.7 * tx_range
+        cells = [((i % cols) * step, (i // cols) * step) for i in range(n)]
+        mid = (cols - 1) * step / 2
+        cells.sort(key=lambda c: math.hypot(c[0] - mid, c[1] - mid))
+        first, rest = cells[0], cells[1:]
+        rng.shuffle(rest)
+        return [first] + rest
+
+    if topology == "random":
+        return [centre] + [(rng.uniform(0, side), rng.uniform(0, side))
+                           for _ in range(n - 1)]
+
+    # cluster: computation nodes are the heads, sensors gather around them
+    heads = [(rng.uniform(0, side), rng.uniform(0, side))
+             for r in roles if r == "computation"] or [centre]
+    pos = [centre]
+    head = iter(heads)
+    for r in roles[1:]:
+        if r == "computation":
+            pos.append(next(head))
+        else:
+            hx, hy = rng.choice(heads)
+            pos.append((rng.gauss(hx, tx_range / 2),
+                        rng.gauss(hy, tx_range / 2)))
+    return pos
+
+
+def split_fields(motes):
+    fields = math.ceil(motes / MAX_FIELD_MOTES)
+    base, extra = divmod(motes, fields)
+    return [base + (i < extra) for i in range(fields)]
+
+
+# -- .csc output -------------------------------------------------------------
+
+def csc_text(title, roles, pos, variant, src_dir, tx_range, success, seed,
+             duration, sockets=False):
+    out = []
+    w = out.append
+    w('<?xml version="1.0" encoding="UTF-8"?>')
+    w('<simconf version="2023090101">')
+    w("  <simulation>")
+    w("    <title>%s</title>" % escape(title))
+    w("    <randomseed>%d</randomseed>" % seed)
+    w("    <motedelay_us>1000000</motedelay_us>")
+    w("    <radiomedium>")
+    w("      org.contikios.cooja.radiomediums.UDGM")
+    w("      <transmitting_range>%.1f</transmitting_range>" % tx_range)
+    w("      <interference_range>%.1f</interference_range>" % (2 * tx_range))
+    w("      <success_ratio_tx>1.0</success_ratio_tx>")
+    w("      <success_ratio_rx>%s</success_ratio_rx>" % success)
+    w("    </radiomedium>")
+    w("    <events>")
+    w("      <logoutput>40000</logoutput>")
+    w("    </events>")
+    for role in ("border", "sensor", "computation"):
+        ids = [i for i, r in enumerate(roles) if r == role]
+        if not ids:
+            continue
+        name = SOURCES[variant][role]
+        w("    <motetype>")
+        w("      org.contikios.cooja.contikimote.ContikiMoteType")
+        w("      <description>%s</description>" % DESCRIPTIONS[role])
+        w("      <source>[CONFIG_DIR]/%s/%s.c</source>" % (src_dir, name))
+        w("      <commands>$(MAKE) -j$(CPUS) %s.cooja TARGET=cooja</commands>"
+          % name)
+        for iface in MOTE_INTERFACES:
+            w("      <moteinterface>%s</moteinterface>" % iface)
+        for i in ids:
+            w("      <mote>")
+            w("        <interface_config>")
+            w("          org.contikios.cooja.interfaces.Position")
+            w('          <pos x="%.3f" y="%.3f" />' % pos[i])
+            w("        </interface_config>")
+            w("        <interface_config>")
+            w("          org.contikios.cooja.contikimote.interfaces."
+              "ContikiMoteID")
+            w("          <id>%d</id>" % (i + 1))
+            w("        </interface_config>")
+            w("      </mote>")
+        w("    </motetype>")
+    w("  </simulation>")
+    if sockets:
+        # border routers are the first motes; e-server.py --sinks N
+        for k in range(roles.count("border")):
+            w("  <plugin>")
+            w("    org.contikios.cooja.serialsocket.SerialSocketServer")
+            w("    <mote_arg>%d</mote_arg>" % k)
+            w("    <plugin_config>")
+            w("      <port>%d</port>" % (60001 + k))
+            w("      <bound>true</bound>")
+            w("    </plugin_config>")
+            w("  </plugin>")
+    if duration:
+        w("  <plugin>")
+        w("    org.contikios.cooja.plugins.ScriptRunner")
+        w("    <plugin_config>")
+        w("      <script>%s</script>"
+          % escape(LOG_SCRIPT % int(duration * 1000)))
+        w("      <active>true</active>")
+        w("    </plugin_config>")
+        w("  </plugin>")
+    w("</simconf>")
+    return "\n".join(out) + "\n"
+
+
+def generate(path, topology, motes, computation, tx_range, success, seed,
+             variant, duration, roots=1, sockets=False):
+    """Write the scenario, return the list of .csc files (one per field)."""
+    rng = random.Random(seed)
+    sizes = split_fields(motes)
+    src_dir = os.path.relpath(os.path.join(ROOT, variant),
+                              os.path.dirname(os.path.abspath(path)))
+    stem = path[:-4] if path.endswith(".csc") else path
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    files = []
+    for k, n in enumerate(sizes):
+        roles = roles_for(n, computation, roots)
+        pos = place(topology, roles, rng, tx_range)
+        name = path if len(sizes) == 1 else "%s.%d.csc" % (stem, k)
+        title = "%s-%s-%d" % (variant, topology, n)
+        with open(name, "w") as f:
+            f.write(csc_text(title, roles, pos, variant, src_dir, tx_range,
+                             success, seed + k, duration, sockets))
+        files.append(name)
+    return files
+
+
+# -- Running -----------------------------------------------------------------
+
+def run_sim(csc, log, seed, duration, variant):
+    binary = "sim" if variant == "energised" else "sim-" + variant
+    subprocess.run([os.path.join(ROOT, "sim", binary), "-c", csc,
+                    "-t", str(duration), "-s", str(seed), "-o", log],
+                   check=True, stderr=subprocess.DEVNULL)
+
+
+def run_cooja(csc, log, seed, duration, variant):
+    run_dir = os.path.dirname(log)
+    cmd = shlex.split(os.environ.get("COOJA", "cooja"))
+    subprocess.run(cmd + ["--no-gui", "--logdir=" + run_dir, csc],
+                   check=True, stdout=subprocess.DEVNULL,
+                   stderr=subprocess.DEVNULL)
+    logs = sorted(glob.glob(os.path.join(run_dir, "*.testlog")),
+                  key=os.path.getmtime)
+    if not logs:
+        raise RuntimeError("%s: Cooja wrote no test log" % csc)
+    os.replace(logs[-1], log)
+
+
+BACKENDS = {"sim": run_sim, "cooja": run_cooja}
+
+
+def run_one(spec):
+    """Generate, run and analyse one point of the sweep."""
+    topology, motes, tx_range, success, seed, args = spec
+    name = "%s-%d-r%g-p%g-s%d" % (topology, motes, tx_range, success, seed)
+    run_dir = os.path.join(args.out, name)
+    os.makedirs(run_dir, exist_ok=True)
+    files = generate(os.path.join(run_dir, "scenario.csc"), topology, motes,
+                     args.computation, tx_range, success, seed, args.variant,
+                     args.duration, args.roots)
+
+    start = time.monotonic()
+    totals = {}
+    joined = lines = 0
+    minutes = 0.0
+    for k, csc in enumerate(files):
+        log = os.path.join(run_dir, "field-%d.txt" % k)
+        BACKENDS[args.backend](csc, log, seed + k, args.duration,
+                               args.variant)
+        r = analyse(log)
+        lines += r["lines"]
+        if r["lines"]:
+            minutes = max(minutes, (r["end"] - r["start"]) / 60)
+        for key, v in r["totals"].items():
+            if key in ("repair_max_s", "cmd_latency_max_s"):
+                totals[key] = max(totals.get(key) or 0, v or 0)
+            else:
+                totals[key] = totals.get(key, 0) + (v or 0)
+        joined += sum(1 for n in r["nodes"].values()
+                      if n["last_parent"] is not None)
+
+    row = dict(topology=topology, motes=motes, fields=len(files),
+               roots=args.roots, range=tx_range, success=success, seed=seed,
+               lines=lines,
+               wall_s=round(time.monotonic() - start, 2))
+    for key in ("readings_sent", "readings_delivered", "duplicates",
+                "forwarded", "aggregated", "skipped_deep_lpm", "hellos", "parent_changes",
+                "parent_losses", "repair_max_s", "deep_lpm_s",
+                "state_changes", "window_drops", "valve_open", "cmd_acked",
+                "cmd_failed", "cmd_latency_max_s"):
+        row[key] = totals.get(key, 0)
+    row["pdr"] = (round(row["readings_delivered"] / row["readings_sent"], 4)
+                  if row["readings_sent"] else None)
+    row["hello_rate"] = (round(row["hellos"] / motes / minutes, 3)
+                         if minutes else None)
+    # share of the non-root motes that ever found a parent
+    row["joined"] = round(joined / (motes - len(files) * args.roots), 4)
+    return row
+
+
+def floats(s):
+    return [float(v) for v in s.split(",")]
+
+
+def ints(s):
+    return [int(v) for v in s.split(",")]
+
+
+def topologies(s):
+    names = s.split(",")
+    for t in names:
+        if t not in TOPOLOGIES:
+            raise argparse.ArgumentTypeError("unknown topology " + t)
+    return names
+
+
+def add_scenario_args(p):
+    p.add_argument("--computation", type=float, default=0.15,
+                   help="share of computation nodes (default: %(default)s)")
+    p.add_argument("--roots", type=int, default=1,
+                   help="border routers per field (default: %(default)s)")
+    p.add_argument("--variant", choices=sorted(SOURCES), default="energised")
+    p.add_argument("--duration", type=float, default=3600,
+                   help="simulated seconds, 0 for an open-ended .csc")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Generate Cooja scenarios and run parallel sweeps")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    g = sub.add_parser("gen", help="write one scenario")
+    g.add_argument("--topology", choices=TOPOLOGIES, default="random")
+    g.add_argument("--motes", type=int, default=50)
+    g.add_argument("--range", type=float, default=50.0,
+                   help="UDGM transmitting range in metres")
+    g.add_argument("--success", type=float, default=1.0,
+                   help="UDGM reception success ratio")
+    g.add_argument("--seed", type=int, default=123456)
+    g.add_argument("-o", "--output", default="scenario.csc")
+    g.add_argument("--serial-sockets", action="store_true",
+                   help="serve each border router's serial port on "
+                        "60001, 60002, ... for e-server.py")
+    add_scenario_args(g)
+
+    s = sub.add_parser("sweep", help="run every parameter combination")
+    s.add_argument("--topology", type=topologies, default=list(TOPOLOGIES))
+    s.add_argument("--motes", type=ints, default=[50, 100, 250, 500])
+    s.add_argument("--range", type=floats, default=[50.0])
+    s.add_argument("--success", type=floats, default=[1.0])
+    s.add_argument("--seeds", type=int, default=3,
+                   help="seeds 1..N per combination (default: %(default)s)")
+    s.add_argument("--backend", choices=sorted(BACKENDS), default="sim")
+    s.add_argument("--out", default="sweep",
+                   help="directory for scenarios and logs")
+    s.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    add_scenario_args(s)
+
+    args = parser.parse_args()
+    if args.roots > 1 and args.variant != "energised":
+        parser.error("only the energised variant supports several roots")
+
+    if args.cmd == "gen":
+        for f in generate(args.output, args.topology, args.motes,
+                          args.computation, args.range, args.success,
+                          args.seed, args.variant, args.duration,
+                          args.roots, args.serial_sockets):
+            print(f)
+        return
+
+    if args.backend == "sim":
+        subprocess.run(["make", "-s", "-C", os.path.join(ROOT, "sim"),
+                        "VARIANT=" + args.variant], check=True)
+    if not args.duration:
+        parser.error("sweeps need a --duration")
+
+    specs = [(t, n, r, p, seed, args) for t, n, r, p, seed in
+             itertools.product(args.topology, args.motes, args.range,
+                               args.success, range(1, args.seeds + 1))]
+    rows = []
+    with Pool(max(1, args.jobs or 1)) as pool:
+        for row in pool.imap_unordered(run_one, specs):
+            rows.append(row)
+            print("%d/%d %s %d motes seed %d: pdr=%s joined=%s (%.1f s)"
+                  % (len(rows), len(specs), row["topology"], row["motes"],
+                     row["seed"], row["pdr"], row["joined"], row["wall_s"]),
+                  file=sys.stderr)
+
+    rows.sort(key=lambda r: [r[k] for k in RUN_FIELDS[:6]])
+    w = csv.DictWriter(sys.stdout, RUN_FIELDS)
+    w.writeheader()
+    w.writerows(rows)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,161 @@
+/* contiki.h -- host simulator subset of the Contiki-NG kernel API */
+
+#ifndef CONTIKI_H_
+#define CONTIKI_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+/*---------------------------------------------------------------------------*/
+/* Clock: ticks of the simulated time */
+typedef unsigned long clock_time_t;
+
+#define CLOCK_SECOND 1000
+
+clock_time_t  clock_time(void);
+unsigned long clock_seconds(void);
+
+/*---------------------------------------------------------------------------*/
+/* Protothreads, local continuations as switch() cases */
+typedef unsigned short lc_t;
+
+#define LC_INIT(s)   s = 0;
+#define LC_RESUME(s) switch(s) { case 0:
+#define LC_SET(s)    s = __LINE__; case __LINE__:
+#define LC_END(s)    }
+
+struct pt {
+  lc_t lc;
+};
+
+#define PT_WAITING   0
+#define PT_YIELDED   1
+#define PT_EXITED    2
+#define PT_ENDED     3
+
+#define PT_THREAD(name_args) char name_args
+#define PT_INIT(pt)          LC_INIT((pt)->lc)
+#define PT_BEGIN(pt)         { char PT_YIELD_FLAG = 1; \
+                               if(PT_YIELD_FLAG) {;} LC_RESUME((pt)->lc)
+#define PT_END(pt)           LC_END((pt)->lc); PT_YIELD_FLAG = 0; \
+                             PT_INIT(pt); return PT_ENDED; }
+#define PT_YIELD(pt)                            \
+  do {                                          \
+    PT_YIELD_FLAG = 0;                          \
+    LC_SET((pt)->lc);                           \
+    if(PT_YIELD_FLAG == 0) {                    \
+      return PT_YIELDED;                        \
+    }                                           \
+  } while(0)
+#define PT_YIELD_UNTIL(pt, cond)                \
+  do {                                          \
+    PT_YIELD_FLAG = 0;                          \
+    LC_SET((pt)->lc);                           \
+    if((PT_YIELD_FLAG == 0) || !(cond)) {       \
+      return PT_YIELDED;                        \
+    }                                           \
+  } while(0)
+
+/*---------------------------------------------------------------------------*/
+/* Processes */
+typedef unsigned char process_event_t;
+typedef void         *process_data_t;
+
+#define PROCESS_EVENT_NONE     0x80
+#define PROCESS_EVENT_INIT     0x81
+#define PROCESS_EVENT_POLL     0x82
+#define PROCESS_EVENT_EXIT     0x83
+#define PROCESS_EVENT_CONTINUE 0x85
+#define PROCESS_EVENT_TIMER    0x88
+
+#define PROCESS_NONE       NULL
+#define PROCESS_BROADCAST  NULL
+
+struct process {
+  struct process *next;
+  const char     *name;
+  PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
+  struct pt       pt;
+  unsigned char   state, needspoll;
+};
+
+#define PROCESS_THREAD(name, ev, data)                          \
+  static PT_THREAD(process_thread_##name(struct pt *process_pt, \
+                                         process_event_t ev,    \
+                                         process_data_t data))
+#define PROCESS_NAME(name) extern struct process name
+#define PROCESS(name, strname)                          \
+  PROCESS_THREAD(name, ev, data);                       \
+  struct process name = { NULL, strname, process_thread_##name }
+#define AUTOSTART_PROCESSES(...)                                        \
+  struct process * const autostart_processes[] = { __VA_ARGS__, NULL }
+
+#define PROCESS_BEGIN()             PT_BEGIN(process_pt)
+#define PROCESS_END()               PT_END(process_pt)
+#define PROCESS_YIELD()             PT_YIELD(process_pt)
+#define PROCESS_WAIT_EVENT()        PROCESS_YIELD()
+#define PROCESS_WAIT_EVENT_UNTIL(c) PT_YIELD_UNTIL(process_pt, c)
+#define PROCESS_PAUSE()                                 \
+  do {                                                  \
+    process_post(PROCESS_CURRENT(), PROCESS_EVENT_CONTINUE, NULL); \
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE); \
+  } while(0)
+
+#define PROCESS_CURRENT() process_current
+#define PROCESS_CONTEXT_BEGIN(p) { \
+  struct process *tmp_current = PROCESS_CURRENT(); \
+  process_current = p
+#define PROCESS_CONTEXT_END(p) process_current = tmp_current; }
+
+extern struct process *process_current;
+
+void            process_start(struct process *p, process_data_t data);
+int             process_post(struct process *p, process_event_t ev,
+                             process_data_t data);
+void            process_poll(struct process *p);
+process_event_t process_alloc_event(void);
+
+/*---------------------------------------------------------------------------*/
+/* Timers */
+struct timer {
+  clock_time_t start;
+  clock_time_t interval;
+};
+
+struct etimer {
+  struct timer    timer;
+  struct etimer  *next;
+  struct process *p;
+};
+
+void         etimer_set(struct etimer *et, clock_time_t interval);
+void         etimer_reset(struct etimer *et);
+void         etimer_restart(struct etimer *et);
+void         etimer_stop(struct etimer *et);
+int          etimer_expired(struct etimer *et);
+clock_time_t etimer_expiration_time(struct etimer *et);
+
+struct ctimer {
+  struct ctimer  *next;
+  struct etimer   etimer;
+  struct process *p;
+  void          (*f)(void *);
+  void           *ptr;
+};
+
+void ctimer_set(struct ctimer *c, clock_time_t t, void (*f)(void *),
+                void *ptr);
+void ctimer_reset(struct ctimer *c);
+void ctimer_restart(struct ctimer *c);
+void ctimer_stop(struct ctimer *c);
+int  ctimer_expired(struct ctimer *c);
+
+#endif /* CONTIKI_H_ */
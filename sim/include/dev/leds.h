@@ -0,0 +1,17 @@
+/* leds.h */
+
+#ifndef LEDS_H_
+#define LEDS_H_
+
+typedef unsigned char leds_mask_t;
+
+#define LEDS_GREEN   1
+#define LEDS_YELLOW  2
+#define LEDS_RED     4
+#define LEDS_ALL     7
+
+void leds_on(leds_mask_t leds);
+void leds_off(leds_mask_t leds);
+void leds_toggle(leds_mask_t leds);
+
+#endif /* LEDS_H_ */
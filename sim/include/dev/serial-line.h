@@ -0,0 +1,14 @@
+/* serial-line.h -- lines written to a mote's serial port by the simulator */
+
+#ifndef SERIAL_LINE_H_
+#define SERIAL_LINE_H_
+
+#include "contiki.h"
+
+#define SERIAL_LINE_CONF_BUFSIZE 128
+
+extern process_event_t serial_line_event_message;
+
+void serial_line_init(void);
+
+#endif /* SERIAL_LINE_H_ */
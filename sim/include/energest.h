@@ -0,0 +1,24 @@
+/* energest.h -- simulator energest, fed by the radio model */
+
+#ifndef ENERGEST_H_
+#define ENERGEST_H_
+
+#include <stdint.h>
+
+typedef enum energest_type {
+  ENERGEST_TYPE_CPU,
+  ENERGEST_TYPE_LPM,
+  ENERGEST_TYPE_DEEP_LPM,
+  ENERGEST_TYPE_TRANSMIT,
+  ENERGEST_TYPE_LISTEN,
+  ENERGEST_TYPE_MAX
+} energest_type_t;
+
+/* Same unit as the clock, so the firmware's energy model is unscaled */
+#define ENERGEST_SECOND 1000
+
+void     energest_init(void);
+void     energest_flush(void);
+uint64_t energest_type_time(energest_type_t type);
+
+#endif /* ENERGEST_H_ */
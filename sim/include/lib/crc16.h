@@ -0,0 +1,10 @@
+/* crc16.h */
+
+#ifndef CRC16_H_
+#define CRC16_H_
+
+unsigned short crc16_add(unsigned char b, unsigned short crc);
+unsigned short crc16_data(const unsigned char *data, int datalen,
+                          unsigned short acc);
+
+#endif /* CRC16_H_ */
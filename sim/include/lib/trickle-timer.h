@@ -0,0 +1,45 @@
+/* trickle-timer.h -- RFC 6206 timer, same API as Contiki-NG */
+
+#ifndef TRICKLE_TIMER_H_
+#define TRICKLE_TIMER_H_
+
+#include "contiki.h"
+
+#define TRICKLE_TIMER_TX_SUPPRESS           0
+#define TRICKLE_TIMER_TX_OK                 1
+#define TRICKLE_TIMER_INFINITE_REDUNDANCY   0
+
+#define TRICKLE_TIMER_ERROR                 0
+#define TRICKLE_TIMER_SUCCESS               1
+
+/* Imin << Imax must fit the clock, with room for the interval's end */
+#define TRICKLE_TIMER_CLOCK_MAX             ((clock_time_t)~0)
+#define TRICKLE_TIMER_IPAIR_IS_BAD(i_min, i_max) \
+  ((TRICKLE_TIMER_CLOCK_MAX >> ((i_max) + 1)) < (i_min) - 1)
+
+typedef void (* trickle_timer_cb_t)(void *ptr, uint8_t suppress);
+
+struct trickle_timer {
+  clock_time_t       i_min;
+  clock_time_t       i_cur;
+  clock_time_t       i_max_abs;
+  clock_time_t       t;
+  trickle_timer_cb_t cb;
+  void              *cb_arg;
+  struct ctimer      ct;
+  uint8_t            i_max;
+  uint8_t            k;
+  uint8_t            c;
+};
+
+uint8_t trickle_timer_config(struct trickle_timer *tt, clock_time_t i_min,
+                             uint8_t i_max, uint8_t k);
+uint8_t trickle_timer_set(struct trickle_timer *tt, trickle_timer_cb_t cb,
+                          void *ptr);
+void    trickle_timer_consistency(struct trickle_timer *tt);
+void    trickle_timer_inconsistency(struct trickle_timer *tt);
+void    trickle_timer_stop(struct trickle_timer *tt);
+
+#define trickle_timer_reset_event(tt) trickle_timer_inconsistency(tt)
+
+#endif /* TRICKLE_TIMER_H_ */
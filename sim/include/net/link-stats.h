@@ -0,0 +1,22 @@
+/* link-stats.h -- per-neighbour ETX and RSSI, as Contiki-NG keeps them */
+
+#ifndef LINK_STATS_H_
+#define LINK_STATS_H_
+
+#include "net/linkaddr.h"
+
+#define LINK_STATS_ETX_DIVISOR  128
+
+struct link_stats {
+  clock_time_t last_tx_time;
+  uint16_t     etx;          /* ETX * LINK_STATS_ETX_DIVISOR */
+  int16_t      rssi;         /* dBm */
+  uint8_t      freshness;
+};
+
+const struct link_stats *link_stats_from_lladdr(const linkaddr_t *lladdr);
+
+/* A frame from `lladdr` is in packetbuf; NullNet leaves this to the app */
+void link_stats_input_callback(const linkaddr_t *lladdr);
+
+#endif /* LINK_STATS_H_ */
@@ -0,0 +1,23 @@
+/* mac.h -- transmission outcomes reported by the simulated MAC */
+
+#ifndef MAC_H_
+#define MAC_H_
+
+enum {
+  MAC_TX_OK,
+  MAC_TX_COLLISION,      /* channel stayed busy */
+  MAC_TX_NOACK,          /* retries used up */
+  MAC_TX_DEFERRED,
+  MAC_TX_ERR,            /* MAC queue full or frame too long */
+  MAC_TX_ERR_FATAL,
+};
+
+typedef void (*mac_callback_t)(void *ptr, int status, int transmissions);
+
+struct mac_driver {
+  char *name;
+  void (*init)(void);
+  void (*send)(mac_callback_t sent, void *ptr);
+};
+
+#endif /* MAC_H_ */
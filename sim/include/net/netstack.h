@@ -0,0 +1,25 @@
+/* netstack.h -- nullnet over the simulated radio */
+
+#ifndef NETSTACK_H_
+#define NETSTACK_H_
+
+#include "net/linkaddr.h"
+#include "net/mac/mac.h"
+
+struct network_driver {
+  char   *name;
+  void  (*init)(void);
+  void  (*input)(void);
+  uint8_t (*output)(const linkaddr_t *localdest);
+};
+
+struct radio_driver {
+  int (*on)(void);
+  int (*off)(void);
+};
+
+extern const struct network_driver NETSTACK_NETWORK;
+extern const struct mac_driver     NETSTACK_MAC;
+extern const struct radio_driver   NETSTACK_RADIO;
+
+#endif /* NETSTACK_H_ */
@@ -0,0 +1,17 @@
+/* nullnet.h */
+
+#ifndef NULLNET_H_
+#define NULLNET_H_
+
+#include "net/linkaddr.h"
+
+typedef void (* nullnet_input_callback)(const void *data, uint16_t len,
+                                        const linkaddr_t *src,
+                                        const linkaddr_t *dest);
+
+extern uint8_t  *nullnet_buf;
+extern uint16_t  nullnet_len;
+
+void nullnet_set_input_callback(nullnet_input_callback callback);
+
+#endif /* NULLNET_H_ */
@@ -0,0 +1,30 @@
+/* packetbuf.h -- the one frame being built or received */
+
+#ifndef PACKETBUF_H_
+#define PACKETBUF_H_
+
+#include "net/linkaddr.h"
+
+#define PACKETBUF_SIZE  127
+
+enum {
+  PACKETBUF_ADDR_SENDER,
+  PACKETBUF_ADDR_RECEIVER,
+};
+
+/* The one attribute the radio sets on a received frame */
+enum {
+  PACKETBUF_ATTR_RSSI,
+  PACKETBUF_NUM_ATTRS
+};
+
+typedef uint16_t packetbuf_attr_t;
+
+void              packetbuf_clear(void);
+int               packetbuf_copyfrom(const void *from, uint16_t len);
+void              packetbuf_set_addr(uint8_t type, const linkaddr_t *addr);
+const linkaddr_t *packetbuf_addr(uint8_t type);
+int               packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val);
+packetbuf_attr_t  packetbuf_attr(uint8_t type);
+
+#endif /* PACKETBUF_H_ */
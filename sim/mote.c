@@ -0,0 +1,1114 @@
+/* mote.c -- the part of Contiki-NG a node role needs, on the host.
+ *
+ * Built once per role with -DMOTE_ROLE=<role> and linked with that
+ * role's firmware. All state below is per-node: it lives in the role's
+ * data sections, which the simulator swaps for every node.
+ */
+
+#include "contiki.h"
+#include "energest.h"
+#include "net/linkaddr.h"
+#include "net/netstack.h"
+#include "net/link-stats.h"
+#include "net/packetbuf.h"
+#include "net/nullnet/nullnet.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "lib/random.h"
+#include "lib/crc16.h"
+#include "lib/trickle-timer.h"
+#include "dev/leds.h"
+#include "dev/serial-line.h"
+#include "mote.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CONCAT3_(a, b, c) a##b##c
+#define CONCAT3(a, b, c)  CONCAT3_(a, b, c)
+#define STR_(x)           #x
+#define STR(x)            STR_(x)
+
+#define US_PER_TICK       (1000000UL / CLOCK_SECOND)
+#define EVENT_QUEUE_LEN   32
+
+extern struct process * const autostart_processes[];
+
+/* Set by the linker for the renamed sections, see the Makefile */
+extern char CONCAT3(__start_mote_, MOTE_ROLE, _data)[];
+extern char CONCAT3(__stop_mote_, MOTE_ROLE, _data)[];
+extern char CONCAT3(__start_mote_, MOTE_ROLE, _bss)[];
+extern char CONCAT3(__stop_mote_, MOTE_ROLE, _bss)[];
+
+/*---------------------------------------------------------------------------*/
+/* Clock */
+clock_time_t
+clock_time(void)
+{
+  return sim_time_us() / US_PER_TICK;
+}
+
+unsigned long
+clock_seconds(void)
+{
+  return sim_time_us() / 1000000UL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Processes and events */
+struct process *process_list;
+struct process *process_current;
+
+static struct event_data {
+  process_event_t ev;
+  process_data_t  data;
+  struct process *p;
+} events[EVENT_QUEUE_LEN];
+static uint8_t         nevents, fevent;
+static uint8_t         poll_requested;
+static process_event_t lastevent = PROCESS_EVENT_TIMER;
+
+#define PROCESS_STATE_NONE    0
+#define PROCESS_STATE_RUNNING 1
+#define PROCESS_STATE_CALLED  2
+
+static void
+exit_process(struct process *p)
+{
+  struct process **q;
+
+  p->state = PROCESS_STATE_NONE;
+  for(q = &process_list; *q != NULL; q = &(*q)->next) {
+    if(*q == p) {
+      *q = p->next;
+      break;
+    }
+  }
+}
+
+static void
+call_process(struct process *p, process_event_t ev, process_data_t data)
+{
+  int ret;
+
+  if(p->state != PROCESS_STATE_RUNNING || p->thread == NULL) {
+    return;
+  }
+  process_current = p;
+  p->state = PROCESS_STATE_CALLED;
+  ret = p->thread(&p->pt, ev, data);
+  if(ret == PT_EXITED || ret == PT_ENDED || ev == PROCESS_EVENT_EXIT) {
+    exit_process(p);
+  } else {
+    p->state = PROCESS_STATE_RUNNING;
+  }
+}
+
+void
+process_start(struct process *p, process_data_t data)
+{
+  struct process *q;
+
+  for(q = process_list; q != NULL; q = q->next) {
+    if(q == p) {
+      return;
+    }
+  }
+  p->next = process_list;
+  process_list = p;
+  p->state = PROCESS_STATE_RUNNING;
+  PT_INIT(&p->pt);
+  call_process(p, PROCESS_EVENT_INIT, data);
+}
+
+int
+process_post(struct process *p, process_event_t ev, process_data_t data)
+{
+  uint8_t slot;
+
+  if(nevents == EVENT_QUEUE_LEN) {
+    return 1;
+  }
+  slot = (fevent + nevents) % EVENT_QUEUE_LEN;
+  events[slot].ev = ev;
+  events[slot].data = data;
+  events[slot].p = p;
+  nevents++;
+  return 0;
+}
+
+void
+process_poll(struct process *p)
+{
+  if(p != NULL) {
+    p->needspoll = 1;
+    poll_requested = 1;
+  }
+}
+
+process_event_t
+process_alloc_event(void)
+{
+  return lastevent++;
+}
+
+static void
+do_poll(void)
+{
+  struct process *p;
+
+  poll_requested = 0;
+  for(p = process_list; p != NULL; p = p->next) {
+    if(p->needspoll) {
+      p->needspoll = 0;
+      call_process(p, PROCESS_EVENT_POLL, NULL);
+    }
+  }
+}
+
+static void
+do_event(void)
+{
+  struct event_data e = events[fevent];
+  struct process *p, *next;
+
+  fevent = (fevent + 1) % EVENT_QUEUE_LEN;
+  nevents--;
+  if(e.p == PROCESS_BROADCAST) {
+    for(p = process_list; p != NULL; p = next) {
+      next = p->next;
+      call_process(p, e.ev, e.data);
+      if(poll_requested) {
+        do_poll();
+      }
+    }
+  } else {
+    call_process(e.p, e.ev, e.data);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Timers */
+static struct etimer *etimer_list;
+static struct ctimer *ctimer_list;
+
+static clock_time_t
+expiration(const struct timer *t)
+{
+  return t->start + t->interval;
+}
+
+static void
+etimer_unlink(struct etimer *et)
+{
+  struct etimer **q;
+
+  for(q = &etimer_list; *q != NULL; q = &(*q)->next) {
+    if(*q == et) {
+      *q = et->next;
+      return;
+    }
+  }
+}
+
+static void
+etimer_add(struct etimer *et)
+{
+  etimer_unlink(et);
+  et->p = PROCESS_CURRENT();
+  et->next = etimer_list;
+  etimer_list = et;
+}
+
+void
+etimer_set(struct etimer *et, clock_time_t interval)
+{
+  et->timer.start = clock_time();
+  et->timer.interval = interval;
+  etimer_add(et);
+}
+
+void
+etimer_reset(struct etimer *et)
+{
+  et->timer.start += et->timer.interval;
+  etimer_add(et);
+}
+
+void
+etimer_restart(struct etimer *et)
+{
+  et->timer.start = clock_time();
+  etimer_add(et);
+}
+
+void
+etimer_stop(struct etimer *et)
+{
+  etimer_unlink(et);
+  et->p = PROCESS_NONE;
+}
+
+int
+etimer_expired(struct etimer *et)
+{
+  return et->p == PROCESS_NONE;
+}
+
+clock_time_t
+etimer_expiration_time(struct etimer *et)
+{
+  return expiration(&et->timer);
+}
+
+static void
+ctimer_unlink(struct ctimer *c)
+{
+  struct ctimer **q;
+
+  for(q = &ctimer_list; *q != NULL; q = &(*q)->next) {
+    if(*q == c) {
+      *q = c->next;
+      return;
+    }
+  }
+}
+
+static void
+ctimer_add(struct ctimer *c)
+{
+  ctimer_unlink(c);
+  c->p = PROCESS_CURRENT();
+  c->next = ctimer_list;
+  ctimer_list = c;
+}
+
+void
+ctimer_set(struct ctimer *c, clock_time_t t, void (*f)(void *), void *ptr)
+{
+  c->f = f;
+  c->ptr = ptr;
+  c->etimer.timer.start = clock_time();
+  c->etimer.timer.interval = t;
+  ctimer_add(c);
+}
+
+void
+ctimer_reset(struct ctimer *c)
+{
+  c->etimer.timer.start += c->etimer.timer.interval;
+  ctimer_add(c);
+}
+
+void
+ctimer_restart(struct ctimer *c)
+{
+  c->etimer.timer.start = clock_time();
+  ctimer_add(c);
+}
+
+void
+ctimer_stop(struct ctimer *c)
+{
+  ctimer_unlink(c);
+}
+
+int
+ctimer_expired(struct ctimer *c)
+{
+  struct ctimer *t;
+
+  for(t = ctimer_list; t != NULL; t = t->next) {
+    if(t == c) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Fire one due timer, returns 0 if none was due */
+static int
+fire_timer(void)
+{
+  clock_time_t now = clock_time();
+  struct etimer *et;
+  struct ctimer *c;
+
+  for(et = etimer_list; et != NULL; et = et->next) {
+    if(expiration(&et->timer) <= now) {
+      struct process *p = et->p;
+      etimer_unlink(et);
+      et->p = PROCESS_NONE;
+      process_post(p, PROCESS_EVENT_TIMER, et);
+      return 1;
+    }
+  }
+  for(c = ctimer_list; c != NULL; c = c->next) {
+    if(expiration(&c->etimer.timer) <= now) {
+      ctimer_unlink(c);
+      PROCESS_CONTEXT_BEGIN(c->p);
+      c->f(c->ptr);
+      PROCESS_CONTEXT_END(c->p);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static uint64_t
+next_expiration_us(void)
+{
+  clock_time_t next = (clock_time_t)-1;
+  struct etimer *et;
+  struct ctimer *c;
+
+  for(et = etimer_list; et != NULL; et = et->next) {
+    next = MIN(next, expiration(&et->timer));
+  }
+  for(c = ctimer_list; c != NULL; c = c->next) {
+    next = MIN(next, expiration(&c->etimer.timer));
+  }
+  return next == (clock_time_t)-1 ? SIM_TIME_NEVER
+                                  : (uint64_t)next * US_PER_TICK;
+}
+
+/*---------------------------------------------------------------------------*/
+/* lib/list */
+void
+list_init(list_t list)
+{
+  *list = NULL;
+}
+
+void *
+list_head(list_t list)
+{
+  return *list;
+}
+
+void *
+list_tail(list_t list)
+{
+  struct list { struct list *next; } *l;
+
+  if(*list == NULL) {
+    return NULL;
+  }
+  for(l = *list; l->next != NULL; l = l->next);
+  return l;
+}
+
+void
+list_remove(list_t list, const void *item)
+{
+  struct list { struct list *next; } **l;
+
+  for(l = (struct list **)list; *l != NULL; l = &(*l)->next) {
+    if(*l == item) {
+      *l = (*l)->next;
+      return;
+    }
+  }
+}
+
+void
+list_add(list_t list, void *item)
+{
+  struct list { struct list *next; } *l;
+
+  list_remove(list, item);
+  ((struct list *)item)->next = NULL;
+  l = list_tail(list);
+  if(l == NULL) {
+    *list = item;
+  } else {
+    l->next = item;
+  }
+}
+
+void
+list_push(list_t list, void *item)
+{
+  struct list { struct list *next; } *l = item;
+
+  list_remove(list, item);
+  l->next = *list;
+  *list = l;
+}
+
+void *
+list_pop(list_t list)
+{
+  struct list { struct list *next; } *l = *list;
+
+  if(l != NULL) {
+    *list = l->next;
+  }
+  return l;
+}
+
+void *
+list_chop(list_t list)
+{
+  void *l = list_tail(list);
+
+  if(l != NULL) {
+    list_remove(list, l);
+  }
+  return l;
+}
+
+int
+list_length(list_t list)
+{
+  struct list { struct list *next; } *l;
+  int n = 0;
+
+  for(l = *list; l != NULL; l = l->next) {
+    n++;
+  }
+  return n;
+}
+
+void
+list_insert(list_t list, void *previtem, void *newitem)
+{
+  struct list { struct list *next; } *prev = previtem, *item = newitem;
+
+  if(prev == NULL) {
+    list_push(list, item);
+  } else {
+    list_remove(list, item);
+    item->next = prev->next;
+    prev->next = item;
+  }
+}
+
+void *
+list_item_next(const void *item)
+{
+  struct list { struct list *next; };
+
+  return item == NULL ? NULL : ((const struct list *)item)->next;
+}
+
+/*---------------------------------------------------------------------------*/
+/* lib/memb */
+void
+memb_init(struct memb *m)
+{
+  memset(m->count, 0, m->num);
+  memset(m->mem, 0, (size_t)m->size * m->num);
+}
+
+void *
+memb_alloc(struct memb *m)
+{
+  int i;
+
+  for(i = 0; i < m->num; i++) {
+    if(m->count[i] == 0) {
+      m->count[i] = 1;
+      return (char *)m->mem + i * m->size;
+    }
+  }
+  return NULL;
+}
+
+int
+memb_inmemb(struct memb *m, void *ptr)
+{
+  return (char *)ptr >= (char *)m->mem
+         && (char *)ptr < (char *)m->mem + m->num * m->size;
+}
+
+char
+memb_free(struct memb *m, void *ptr)
+{
+  int i;
+
+  if(!memb_inmemb(m, ptr)) {
+    return -1;
+  }
+  i = ((char *)ptr - (char *)m->mem) / m->size;
+  if(m->count[i] > 0) {
+    m->count[i]--;
+  }
+  return m->count[i];
+}
+
+int
+memb_numfree(struct memb *m)
+{
+  int i, n = 0;
+
+  for(i = 0; i < m->num; i++) {
+    n += m->count[i] == 0;
+  }
+  return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* lib/random: per-node xorshift, seeded at boot */
+static uint32_t rand_state;
+
+void
+random_init(unsigned short seed)
+{
+  rand_state = 2463534242UL ^ ((uint32_t)seed * 2654435761UL);
+  if(rand_state == 0) {
+    rand_state = 1;
+  }
+}
+
+unsigned short
+random_rand(void)
+{
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return (unsigned short)(rand_state >> 8);
+}
+
+/*---------------------------------------------------------------------------*/
+/* lib/crc16, as in Contiki */
+unsigned short
+crc16_add(unsigned char b, unsigned short acc)
+{
+  acc ^= b;
+  acc  = (acc >> 8) | (acc << 8);
+  acc ^= (acc & 0xff00) << 4;
+  acc ^= (acc >> 8) >> 4;
+  acc ^= (acc & 0xff00) >> 5;
+  return acc;
+}
+
+unsigned short
+crc16_data(const unsigned char *data, int len, unsigned short acc)
+{
+  int i;
+
+  for(i = 0; i < len; i++) {
+    acc = crc16_add(data[i], acc);
+  }
+  return acc;
+}
+
+/*---------------------------------------------------------------------------*/
+/* lib/trickle-timer: RFC 6206, the first interval is Imin */
+static void trickle_interval_end(void *ptr);
+
+static void
+trickle_fire(void *ptr)
+{
+  struct trickle_timer *tt = ptr;
+
+  ctimer_set(&tt->ct, tt->i_cur - tt->t, trickle_interval_end, tt);
+  if(tt->cb) {
+    tt->cb(tt->cb_arg, (tt->k == TRICKLE_TIMER_INFINITE_REDUNDANCY
+                        || tt->c < tt->k) ? TRICKLE_TIMER_TX_OK
+                                          : TRICKLE_TIMER_TX_SUPPRESS);
+  }
+}
+
+static void
+trickle_new_interval(struct trickle_timer *tt)
+{
+  clock_time_t half = tt->i_cur / 2;
+
+  tt->c = 0;
+  tt->t = half + (half ? random_rand() % half : 0);
+  ctimer_set(&tt->ct, tt->t, trickle_fire, tt);
+}
+
+static void
+trickle_interval_end(void *ptr)
+{
+  struct trickle_timer *tt = ptr;
+
+  tt->i_cur = MIN(tt->i_cur * 2, tt->i_max_abs);
+  trickle_new_interval(tt);
+}
+
+uint8_t
+trickle_timer_config(struct trickle_timer *tt, clock_time_t i_min,
+                     uint8_t i_max, uint8_t k)
+{
+  if(TRICKLE_TIMER_IPAIR_IS_BAD(i_min, i_max)) {
+    return TRICKLE_TIMER_ERROR;
+  }
+  tt->i_min = i_min;
+  tt->i_max = i_max;
+  tt->i_max_abs = i_min << i_max;
+  tt->k = k;
+  tt->cb = NULL;
+  return TRICKLE_TIMER_SUCCESS;
+}
+
+uint8_t
+trickle_timer_set(struct trickle_timer *tt, trickle_timer_cb_t cb, void *ptr)
+{
+  tt->cb = cb;
+  tt->cb_arg = ptr;
+  tt->i_cur = tt->i_min;
+  trickle_new_interval(tt);
+  return 1;
+}
+
+void
+trickle_timer_consistency(struct trickle_timer *tt)
+{
+  if(tt->c < 0xff) {
+    tt->c++;
+  }
+}
+
+void
+trickle_timer_inconsistency(struct trickle_timer *tt)
+{
+  if(tt->cb != NULL && tt->i_cur != tt->i_min) {
+    tt->i_cur = tt->i_min;
+    trickle_new_interval(tt);
+  }
+}
+
+void
+trickle_timer_stop(struct trickle_timer *tt)
+{
+  ctimer_stop(&tt->ct);
+}
+
+/*---------------------------------------------------------------------------*/
+/* energest: the simulator keeps the books, we only change the unit */
+void
+energest_init(void)
+{
+}
+
+void
+energest_flush(void)
+{
+}
+
+uint64_t
+energest_type_time(energest_type_t type)
+{
+  uint64_t us;
+
+  if(type == ENERGEST_TYPE_LPM) {
+    us = sim_time_us() - sim_energest_us(ENERGEST_TYPE_CPU);
+  } else {
+    us = sim_energest_us(type);
+  }
+  return us * ENERGEST_SECOND / 1000000UL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Link addresses: u8[0] is the node ID */
+linkaddr_t       linkaddr_node_addr;
+const linkaddr_t linkaddr_null;
+
+void
+linkaddr_copy(linkaddr_t *dest, const linkaddr_t *from)
+{
+  memcpy(dest, from, LINKADDR_SIZE);
+}
+
+int
+linkaddr_cmp(const linkaddr_t *addr1, const linkaddr_t *addr2)
+{
+  return memcmp(addr1, addr2, LINKADDR_SIZE) == 0;
+}
+
+void
+linkaddr_set_node_addr(linkaddr_t *addr)
+{
+  linkaddr_copy(&linkaddr_node_addr, addr);
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+ * link-stats, updated the way Contiki-NG does: CSMA reports every unicast,
+ * received frames only count when the firmware passes them on
+ */
+#define LINK_STATS_NBRS           32
+#define LINK_STATS_ETX_ALPHA      90      /* EWMA weight of the old ETX, % */
+#define LINK_STATS_NOACK_PENALTY  12      /* ETX charged for a lost frame */
+#define LINK_STATS_RSSI_ALPHA     70
+
+static struct link_nbr {
+  uint8_t           id;
+  struct link_stats stats;
+} link_nbrs[LINK_STATS_NBRS];
+
+static struct link_nbr *
+link_nbr(uint8_t id, int create)
+{
+  struct link_nbr *oldest = NULL;
+  int i;
+
+  for(i = 0; i < LINK_STATS_NBRS; i++) {
+    if(link_nbrs[i].id == id) {
+      return &link_nbrs[i];
+    }
+    if(oldest == NULL
+       || link_nbrs[i].stats.last_tx_time < oldest->stats.last_tx_time) {
+      oldest = &link_nbrs[i];
+    }
+  }
+  if(!create) {
+    return NULL;
+  }
+  memset(oldest, 0, sizeof(*oldest));
+  oldest->id = id;
+  return oldest;
+}
+
+/* Contiki-NG's guess_etx_from_rssi(): 1 / PRR, the PRR falling linearly
+   from 1 at -60 dBm to 0 at -90 dBm, and at most 3 */
+static uint16_t
+etx_from_rssi(int16_t rssi)
+{
+  int16_t bounded = MAX(MIN(rssi, -60), -90 + 1);
+
+  return MIN(30 * LINK_STATS_ETX_DIVISOR / (bounded + 90),
+             3 * LINK_STATS_ETX_DIVISOR);
+}
+
+const struct link_stats *
+link_stats_from_lladdr(const linkaddr_t *lladdr)
+{
+  struct link_nbr *n = link_nbr(lladdr->u8[0], 0);
+
+  return n == NULL ? NULL : &n->stats;
+}
+
+void
+link_stats_input_callback(const linkaddr_t *lladdr)
+{
+  struct link_nbr *n = link_nbr(lladdr->u8[0], 0);
+  int16_t rssi = (int16_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+
+  if(n == NULL) {
+    n = link_nbr(lladdr->u8[0], 1);
+    n->stats.rssi = rssi;
+    n->stats.etx = etx_from_rssi(rssi);
+    n->stats.last_tx_time = clock_time();
+    return;
+  }
+  n->stats.rssi = (n->stats.rssi * LINK_STATS_RSSI_ALPHA
+                   + rssi * (100 - LINK_STATS_RSSI_ALPHA)) / 100;
+}
+
+static void
+link_stats_sent(uint8_t id, int status, uint8_t tx)
+{
+  struct link_nbr *n;
+  uint32_t packet_etx;
+
+  if(status != MAC_TX_OK && status != MAC_TX_NOACK) {
+    return;                 /* never made it to the air */
+  }
+  n = link_nbr(id, 1);
+  packet_etx = (status == MAC_TX_OK ? tx : LINK_STATS_NOACK_PENALTY)
+               * LINK_STATS_ETX_DIVISOR;
+
+  if(n->stats.etx == 0) {
+    /* never heard (or not passed on): no RSSI to guess from, ETX 2 */
+    n->stats.etx = 2 * LINK_STATS_ETX_DIVISOR;
+  }
+  n->stats.etx = (n->stats.etx * LINK_STATS_ETX_ALPHA
+                  + packet_etx * (100 - LINK_STATS_ETX_ALPHA)) / 100;
+  n->stats.last_tx_time = clock_time();
+  if(n->stats.freshness < 0xff) {
+    n->stats.freshness++;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* packetbuf and a MAC in front of the simulated radio */
+#define MAC_PENDING  16
+
+static uint8_t          pb[PACKETBUF_SIZE];
+static uint16_t         pb_len;
+static linkaddr_t       pb_addr[2];
+static packetbuf_attr_t pb_attr[PACKETBUF_NUM_ATTRS];
+
+/* callbacks of unicasts in flight; the simulator completes them in order */
+static struct {
+  mac_callback_t sent;
+  void          *ptr;
+} mac_pending[MAC_PENDING];
+static uint8_t mac_first, mac_count;
+
+void
+packetbuf_clear(void)
+{
+  pb_len = 0;
+  memset(pb_addr, 0, sizeof(pb_addr));
+  memset(pb_attr, 0, sizeof(pb_attr));
+}
+
+int
+packetbuf_copyfrom(const void *from, uint16_t len)
+{
+  pb_len = MIN(len, PACKETBUF_SIZE);
+  memcpy(pb, from, pb_len);
+  return pb_len;
+}
+
+void
+packetbuf_set_addr(uint8_t type, const linkaddr_t *addr)
+{
+  linkaddr_copy(&pb_addr[type], addr);
+}
+
+const linkaddr_t *
+packetbuf_addr(uint8_t type)
+{
+  return &pb_addr[type];
+}
+
+int
+packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val)
+{
+  pb_attr[type] = val;
+  return 1;
+}
+
+packetbuf_attr_t
+packetbuf_attr(uint8_t type)
+{
+  return pb_attr[type];
+}
+
+static void
+mac_send(mac_callback_t sent, void *ptr)
+{
+  const linkaddr_t *dest = &pb_addr[PACKETBUF_ADDR_RECEIVER];
+  int broadcast = linkaddr_cmp(dest, &linkaddr_null);
+  uint8_t slot;
+
+  if(!sim_radio_send(pb, pb_len, dest->u8[0], broadcast)) {
+    if(sent) {
+      sent(ptr, MAC_TX_ERR, 0);
+    }
+    return;
+  }
+  if(broadcast) {
+    if(sent) {
+      sent(ptr, MAC_TX_OK, 1);
+    }
+    return;
+  }
+  slot = (mac_first + mac_count) % MAC_PENDING;
+  mac_pending[slot].sent = sent;
+  mac_pending[slot].ptr = ptr;
+  if(mac_count < MAC_PENDING) {
+    mac_count++;
+  }
+}
+
+const struct mac_driver NETSTACK_MAC = { "sim-csma", NULL, mac_send };
+
+/*---------------------------------------------------------------------------*/
+/* nullnet straight onto the simulated radio */
+uint8_t                       *nullnet_buf;
+uint16_t                       nullnet_len;
+static nullnet_input_callback  input_cb;
+
+void
+nullnet_set_input_callback(nullnet_input_callback callback)
+{
+  input_cb = callback;
+}
+
+static uint8_t
+nullnet_output(const linkaddr_t *dest)
+{
+  packetbuf_clear();
+  packetbuf_copyfrom(nullnet_buf, nullnet_len);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER,
+                     dest != NULL ? dest : &linkaddr_null);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
+  NETSTACK_MAC.send(NULL, NULL);
+  return 1;
+}
+
+static int
+radio_on(void)
+{
+  sim_radio_set(1);
+  return 1;
+}
+
+static int
+radio_off(void)
+{
+  sim_radio_set(0);
+  return 1;
+}
+
+const struct network_driver NETSTACK_NETWORK = {
+  "nullnet", NULL, NULL, nullnet_output
+};
+const struct radio_driver NETSTACK_RADIO = { radio_on, radio_off };
+
+/*---------------------------------------------------------------------------*/
+/* LEDs are not modelled */
+void
+leds_on(leds_mask_t leds)
+{
+}
+
+void
+leds_off(leds_mask_t leds)
+{
+}
+
+void
+leds_toggle(leds_mask_t leds)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+ * Serial port: printf() and putc() (which putchar() inlines to) are
+ * renamed to mote_printf() and mote_putc() in the role object
+ */
+process_event_t serial_line_event_message;
+static char     serial_rx[SERIAL_LINE_CONF_BUFSIZE];
+static char     serial_tx[256];
+static uint16_t serial_tx_len;
+
+void
+serial_line_init(void)
+{
+}
+
+static void
+serial_put(char c)
+{
+  if(c == '\n' || serial_tx_len == sizeof(serial_tx) - 1) {
+    serial_tx[serial_tx_len] = '\0';
+    sim_log(serial_tx);
+    serial_tx_len = 0;
+    if(c == '\n') {
+      return;
+    }
+  }
+  serial_tx[serial_tx_len++] = c;
+}
+
+int mote_printf(const char *fmt, ...);
+int mote_putc(int c, FILE *stream);
+
+int
+mote_printf(const char *fmt, ...)
+{
+  char buf[256];
+  va_list ap;
+  int n, i;
+
+  va_start(ap, fmt);
+  n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  for(i = 0; i < n && i < (int)sizeof(buf) - 1; i++) {
+    serial_put(buf[i]);
+  }
+  return n;
+}
+
+int
+mote_putc(int c, FILE *stream)
+{
+  serial_put((char)c);
+  return (unsigned char)c;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Entry points used by the simulator */
+static void
+mote_boot(uint8_t id, uint16_t seed)
+{
+  int i;
+
+  linkaddr_node_addr.u8[0] = id;
+  random_init(seed);
+  serial_line_event_message = process_alloc_event();
+  for(i = 0; autostart_processes[i] != NULL; i++) {
+    process_start(autostart_processes[i], NULL);
+  }
+}
+
+static uint64_t
+mote_run(void)
+{
+  for(;;) {
+    if(poll_requested) {
+      do_poll();
+    } else if(nevents > 0) {
+      do_event();
+    } else if(!fire_timer()) {
+      break;
+    }
+  }
+  return next_expiration_us();
+}
+
+/* As nullnet does, the frame and its sender are handed up in packetbuf */
+static void
+mote_input(const uint8_t *data, uint16_t len, uint8_t src, int broadcast,
+           int8_t rssi)
+{
+  linkaddr_t from = linkaddr_null;
+
+  from.u8[0] = src;
+  packetbuf_clear();
+  packetbuf_copyfrom(data, len);
+  packetbuf_set_attr(PACKETBUF_ATTR_RSSI, (packetbuf_attr_t)rssi);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &from);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER,
+                     broadcast ? &linkaddr_null : &linkaddr_node_addr);
+  if(input_cb != NULL) {
+    input_cb(pb, pb_len, packetbuf_addr(PACKETBUF_ADDR_SENDER),
+             packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+  }
+}
+
+static void
+mote_sent(uint8_t dest, int status, uint8_t tx)
+{
+  link_stats_sent(dest, status, tx);
+  if(mac_count > 0) {
+    uint8_t slot = mac_first;
+    mac_first = (mac_first + 1) % MAC_PENDING;
+    mac_count--;
+    if(mac_pending[slot].sent) {
+      mac_pending[slot].sent(mac_pending[slot].ptr, status, tx);
+    }
+  }
+}
+
+static void
+mote_serial_input(const char *line)
+{
+  strncpy(serial_rx, line, sizeof(serial_rx) - 1);
+  serial_rx[sizeof(serial_rx) - 1] = '\0';
+  process_post(PROCESS_BROADCAST, serial_line_event_message, serial_rx);
+}
+
+__attribute__((visibility("default")))
+const struct mote_api CONCAT3(mote_, MOTE_ROLE, _api) = {
+  STR(MOTE_ROLE),
+  CONCAT3(__start_mote_, MOTE_ROLE, _data),
+  CONCAT3(__stop_mote_, MOTE_ROLE, _data),
+  CONCAT3(__start_mote_, MOTE_ROLE, _bss),
+  CONCAT3(__stop_mote_, MOTE_ROLE, _bss),
+  mote_boot,
+  mote_run,
+  mote_input,
+  mote_sent,
+  mote_serial_input
+};
+/*---------------------------------------------------------------------------*/
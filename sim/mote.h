@@ -0,0 +1,50 @@
+/* mote.h -- interface between the simulator and one compiled node role */
+
+#ifndef MOTE_H_
+#define MOTE_H_
+
+#include <stdint.h>
+
+#define SIM_TIME_NEVER  UINT64_MAX
+
+/*
+ * Each role (firmware plus mote.c) is linked into one relocatable object
+ * whose writable data lives in two renamed sections. The simulator keeps
+ * one copy of that memory per node and swaps it in before calling into
+ * the role, the way Cooja runs native motes.
+ */
+struct mote_api {
+  const char *name;
+  char       *data_start, *data_end;
+  char       *bss_start, *bss_end;
+
+  /* Start the kernel and the autostart processes */
+  void     (*boot)(uint8_t id, uint16_t seed);
+
+  /* Run due timers and queued events, return the next wake-up in us */
+  uint64_t (*run)(void);
+
+  /* A frame addressed to us (or broadcast) was received */
+  void     (*input)(const uint8_t *data, uint16_t len, uint8_t src,
+                    int broadcast, int8_t rssi);
+
+  /* A unicast we sent is done: a MAC_TX_* status after `tx` attempts */
+  void     (*sent)(uint8_t dest, int status, uint8_t tx);
+
+  /* A line arrived on the serial port */
+  void     (*serial_input)(const char *line);
+};
+
+extern const struct mote_api mote_sensor_api;
+extern const struct mote_api mote_computation_api;
+extern const struct mote_api mote_border_api;
+
+/* Services the simulator offers to the running mote */
+uint64_t sim_time_us(void);
+int      sim_radio_send(const uint8_t *data, uint16_t len, uint8_t dest,
+                        int broadcast);    /* 0 if the MAC queue is full */
+void     sim_radio_set(int on);
+uint64_t sim_energest_us(int type);
+void     sim_log(const char *line);
+
+#endif /* MOTE_H_ */
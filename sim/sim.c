@@ -0,0 +1,785 @@
+/* sim.c -- discrete-event simulator for the energised node roles.
+ *
+ * The sensor, computation and border-router firmware is linked unchanged
+ * against a host build of the kernel (mote.c) and driven by an event
+ * queue: timer wake-ups, radio transmissions and deliveries. The radio
+ * follows Cooja's UDGM (transmission and interference ranges, success
+ * ratio), with collisions, CCA and unicast retransmissions as CSMA does.
+ *
+ * Node output goes to Cooja-style logs ("mm:ss.mmm\tID:n\t..."), so
+ * result.py reads them like a Cooja run.
+ *
+ *   ./sim -c ../energised/noEnergised.csc -t 7200 -o run.txt
+ *   ./sim -n 250 -f 16 -t 7200 -q          # 16 networks of 250 nodes
+ *   ./sim -c scenario.csc -k 4:1800        # node 4 fails after 30 min
+ */
+
+#include "mote.h"
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Mirrors sim/include/energest.h */
+#define ENERGEST_TYPE_CPU       0
+#define ENERGEST_TYPE_TRANSMIT  3
+#define ENERGEST_TYPE_LISTEN    4
+
+/* Mirrors sim/include/net/mac/mac.h */
+#define MAC_TX_OK               0
+#define MAC_TX_COLLISION        1
+#define MAC_TX_NOACK            2
+
+#define MAX_FIELD_NODES    254     /* node IDs are one byte on the air */
+#define FRAME_MAX          127
+#define PHY_OVERHEAD       17      /* PHY + 802.15.4 header bytes */
+#define US_PER_BYTE        32      /* 250 kbit/s */
+#define BACKOFF_UNIT_US    320
+#define MAC_MIN_BE         3
+#define MAC_MAX_BE         5
+#define MAC_MAX_BACKOFFS   5
+#define MAC_MAX_RETRIES    3
+#define MAC_QUEUE_LEN      8
+#define CPU_US_PER_WAKEUP  200     /* charged to energest CPU per activation */
+#define RSSI_STRONG        -10     /* dBm at distance 0, as Cooja's UDGM */
+#define RSSI_WEAK          -95     /* dBm at the edge of the range */
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+enum role { ROLE_SENSOR, ROLE_COMPUTATION, ROLE_BORDER, ROLE_COUNT };
+
+static const struct mote_api *const role_api[ROLE_COUNT] = {
+  &mote_sensor_api, &mote_computation_api, &mote_border_api
+};
+
+struct tx {
+  struct tx *next;
+  uint32_t   sender;
+  uint8_t    dest;
+  uint8_t    broadcast;
+  uint8_t    attempts, backoffs;
+  uint16_t   len;
+  uint64_t   end;
+  uint8_t    data[FRAME_MAX];
+};
+
+struct nbr {
+  uint32_t node;
+  uint8_t  in_range;            /* else only within interference range */
+  float    dist;                /* distance / tx_range */
+};
+
+struct node {
+  enum role   role;
+  uint8_t     id;
+  uint16_t    field;
+  double      x, y;
+  char       *image;
+  uint64_t    wake_at;
+
+  struct nbr *nbrs;
+  uint32_t    n_nbrs, cap_nbrs;
+
+  /* radio */
+  uint8_t     radio_on;
+  uint8_t     dead;
+  uint64_t    on_since, listen_us, tx_us, cpu_us;
+  uint64_t    rx_busy_until;
+  struct tx  *rx_tx;            /* frame being received, NULL if corrupt */
+  struct tx  *mac_queue;        /* head is on the air or backing off */
+  uint8_t     mac_len;
+};
+
+struct role_mem {
+  size_t       data_len, bss_len;
+  char        *pristine;
+  struct node *loaded;
+};
+
+enum { EV_BOOT, EV_WAKE, EV_TX_START, EV_TX_END, EV_KILL };
+
+struct event {
+  uint64_t t, seq;
+  uint32_t node;
+  uint8_t  type;
+  void    *ptr;
+};
+
+static struct node     *nodes;
+static uint32_t         n_nodes;
+static struct role_mem  roles[ROLE_COUNT];
+static struct node     *current;
+static uint64_t         now_us;
+
+static struct event    *heap;
+static size_t           heap_len, heap_cap;
+static uint64_t         event_seq;
+
+static FILE           **field_logs;
+static uint16_t         n_fields = 1;
+static int              quiet;
+
+static double           tx_range = 50.0, int_range = 100.0, success_ratio = 1.0;
+static uint64_t         rng_state = 88172645463325252ULL;
+
+static struct {
+  uint64_t events, wakeups, frames, bytes, deliveries, collisions,
+           mac_drops, retries, lines;
+} stats;
+
+/*---------------------------------------------------------------------------*/
+static void
+die(const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+  exit(1);
+}
+
+static uint64_t
+rng(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static double
+rng_unit(void)
+{
+  return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Event queue: binary min-heap on (time, insertion order) */
+static int
+event_before(const struct event *a, const struct event *b)
+{
+  return a->t < b->t || (a->t == b->t && a->seq < b->seq);
+}
+
+static void
+schedule(uint64_t t, uint8_t type, uint32_t node, void *ptr)
+{
+  size_t i;
+
+  if(heap_len == heap_cap) {
+    heap_cap = heap_cap ? heap_cap * 2 : 1024;
+    heap = realloc(heap, heap_cap * sizeof(*heap));
+    if(heap == NULL) {
+      die("out of memory");
+    }
+  }
+  i = heap_len++;
+  heap[i] = (struct event){ t, event_seq++, node, type, ptr };
+  while(i > 0 && event_before(&heap[i], &heap[(i - 1) / 2])) {
+    struct event tmp = heap[i];
+    heap[i] = heap[(i - 1) / 2];
+    heap[(i - 1) / 2] = tmp;
+    i = (i - 1) / 2;
+  }
+}
+
+static struct event
+next_event(void)
+{
+  struct event top = heap[0];
+  size_t i = 0;
+
+  heap[0] = heap[--heap_len];
+  for(;;) {
+    size_t l = 2 * i + 1, r = l + 1, m = i;
+    if(l < heap_len && event_before(&heap[l], &heap[m])) {
+      m = l;
+    }
+    if(r < heap_len && event_before(&heap[r], &heap[m])) {
+      m = r;
+    }
+    if(m == i) {
+      break;
+    }
+    struct event tmp = heap[i];
+    heap[i] = heap[m];
+    heap[m] = tmp;
+    i = m;
+  }
+  return top;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Mote memory: swap a node's data and bss in, saving the previous node */
+static void
+save_node(struct node *n)
+{
+  const struct mote_api *api = role_api[n->role];
+  struct role_mem *r = &roles[n->role];
+
+  memcpy(n->image, api->data_start, r->data_len);
+  memcpy(n->image + r->data_len, api->bss_start, r->bss_len);
+}
+
+static void
+activate(struct node *n)
+{
+  const struct mote_api *api = role_api[n->role];
+  struct role_mem *r = &roles[n->role];
+
+  if(r->loaded != n) {
+    if(r->loaded != NULL) {
+      save_node(r->loaded);
+    }
+    memcpy(api->data_start, n->image, r->data_len);
+    memcpy(api->bss_start, n->image + r->data_len, r->bss_len);
+    r->loaded = n;
+  }
+  current = n;
+  n->cpu_us += CPU_US_PER_WAKEUP;
+  stats.wakeups++;
+}
+
+/* Run the node's pending work and re-arm its wake-up */
+static void
+settle(struct node *n)
+{
+  uint64_t next = role_api[n->role]->run();
+
+  current = NULL;
+  if(next < now_us) {
+    next = now_us;
+  }
+  if(next != n->wake_at) {
+    n->wake_at = next;
+    if(next != SIM_TIME_NEVER) {
+      schedule(next, EV_WAKE, n - nodes, NULL);
+    }
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Services for the running mote */
+uint64_t
+sim_time_us(void)
+{
+  return now_us;
+}
+
+uint64_t
+sim_energest_us(int type)
+{
+  struct node *n = current;
+
+  switch(type) {
+  case ENERGEST_TYPE_CPU:
+    return n->cpu_us;
+  case ENERGEST_TYPE_TRANSMIT:
+    return n->tx_us;
+  case ENERGEST_TYPE_LISTEN:
+    return n->listen_us + (n->radio_on ? now_us - n->on_since : 0);
+  default:
+    return 0;
+  }
+}
+
+void
+sim_radio_set(int on)
+{
+  struct node *n = current;
+
+  if(on && !n->radio_on) {
+    n->on_since = now_us;
+  } else if(!on && n->radio_on) {
+    n->listen_us += now_us - n->on_since;
+    n->rx_tx = NULL;
+  }
+  n->radio_on = on;
+}
+
+static uint64_t
+backoff(uint8_t be)
+{
+  return (rng() % (1u << be)) * BACKOFF_UNIT_US;
+}
+
+int
+sim_radio_send(const uint8_t *data, uint16_t len, uint8_t dest, int broadcast)
+{
+  struct node *n = current;
+  struct tx *t, **q;
+
+  if(len > FRAME_MAX || n->mac_len == MAC_QUEUE_LEN) {
+    stats.mac_drops++;
+    return 0;
+  }
+  t = calloc(1, sizeof(*t));
+  t->sender = n - nodes;
+  t->dest = dest;
+  t->broadcast = broadcast;
+  t->len = len;
+  memcpy(t->data, data, len);
+  for(q = &n->mac_queue; *q != NULL; q = &(*q)->next);
+  *q = t;
+  if(n->mac_len++ == 0) {
+    schedule(now_us + backoff(MAC_MIN_BE), EV_TX_START, t->sender, t);
+  }
+  return 1;
+}
+
+static void
+print_time(FILE *f, uint64_t us)
+{
+  uint64_t ms = us / 1000;
+  unsigned h = ms / 3600000, m = ms / 60000 % 60, s = ms / 1000 % 60;
+
+  if(h > 0) {
+    fprintf(f, "%u:%02u:%02u.%03u", h, m, s, (unsigned)(ms % 1000));
+  } else {
+    fprintf(f, "%02u:%02u.%03u", m, s, (unsigned)(ms % 1000));
+  }
+}
+
+void
+sim_log(const char *line)
+{
+  FILE *f;
+
+  stats.lines++;
+  if(quiet) {
+    return;
+  }
+  f = field_logs[current->field];
+  print_time(f, now_us);
+  fprintf(f, "\tID:%u\t%s\n", current->id, line);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Radio medium */
+static uint64_t
+airtime(uint16_t len)
+{
+  return (uint64_t)(len + PHY_OVERHEAD) * US_PER_BYTE;
+}
+
+/* UDGM: the success ratio is reached at the edge of the range, falling
+   with the square of the distance */
+static int
+link_ok(float dist)
+{
+  return rng_unit() < 1.0 - dist * dist * (1.0 - success_ratio);
+}
+
+/* Tell the sender how its unicast went */
+static void
+mac_report(struct node *n, struct tx *t, int status, uint8_t tx)
+{
+  if(t->broadcast || n->dead) {
+    return;
+  }
+  activate(n);
+  role_api[n->role]->sent(t->dest, status, tx);
+  settle(n);
+}
+
+static void
+mac_next(struct node *n)
+{
+  struct tx *t = n->mac_queue;
+
+  n->mac_queue = t->next;
+  n->mac_len--;
+  free(t);
+  if(n->mac_queue != NULL) {
+    schedule(now_us + backoff(MAC_MIN_BE), EV_TX_START, n - nodes,
+             n->mac_queue);
+  }
+}
+
+static void
+tx_start(struct node *n, struct tx *t)
+{
+  uint32_t i;
+
+  /* CCA: back off while we hear someone else */
+  if(n->radio_on && n->rx_busy_until > now_us) {
+    if(++t->backoffs > MAC_MAX_BACKOFFS) {
+      stats.mac_drops++;
+      mac_report(n, t, MAC_TX_COLLISION, t->attempts);
+      mac_next(n);
+      return;
+    }
+    schedule(now_us + backoff(MIN(MAC_MIN_BE + t->backoffs, MAC_MAX_BE)),
+             EV_TX_START, n - nodes, t);
+    return;
+  }
+
+  t->end = now_us + airtime(t->len);
+  n->tx_us += t->end - now_us;
+  n->rx_tx = NULL;               /* half duplex */
+  stats.frames++;
+  stats.bytes += t->len;
+  for(i = 0; i < n->n_nbrs; i++) {
+    struct node *r = &nodes[n->nbrs[i].node];
+    if(r->rx_busy_until > now_us) {
+      /* overlapping signals: both frames are lost at this receiver */
+      if(r->rx_tx != NULL) {
+        stats.collisions++;
+      }
+      r->rx_tx = NULL;
+      r->rx_busy_until = MAX(r->rx_busy_until, t->end);
+    } else {
+      r->rx_busy_until = t->end;
+      r->rx_tx = (n->nbrs[i].in_range && r->radio_on) ? t : NULL;
+    }
+  }
+  schedule(t->end, EV_TX_END, n - nodes, t);
+}
+
+static void
+tx_end(struct node *n, struct tx *t)
+{
+  int acked = 0;
+  uint32_t i;
+
+  for(i = 0; i < n->n_nbrs; i++) {
+    struct node *r = &nodes[n->nbrs[i].node];
+    float dist = n->nbrs[i].dist;
+    if(r->rx_tx != t) {
+      continue;
+    }
+    r->rx_tx = NULL;
+    if(!r->radio_on || !link_ok(dist)) {
+      continue;
+    }
+    if(!t->broadcast && r->id != t->dest) {
+      continue;
+    }
+    /* the ack crosses the same link back, to a sender still listening */
+    acked |= !t->broadcast && n->radio_on && link_ok(dist);
+    stats.deliveries++;
+    activate(r);
+    role_api[r->role]->input(t->data, t->len, n->id, t->broadcast,
+                             (int8_t)(RSSI_STRONG
+                                      + dist * (RSSI_WEAK - RSSI_STRONG)));
+    settle(r);
+  }
+
+  if(!t->broadcast && !acked && ++t->attempts <= MAC_MAX_RETRIES) {
+    stats.retries++;
+    t->backoffs = 0;
+    schedule(now_us + backoff(MAC_MAX_BE), EV_TX_START, n - nodes, t);
+    return;
+  }
+  mac_report(n, t, acked ? MAC_TX_OK : MAC_TX_NOACK,
+             acked ? t->attempts + 1 : t->attempts);
+  mac_next(n);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Topology */
+static struct node *
+add_node(enum role role, uint8_t id, uint16_t field, double x, double y)
+{
+  struct node *n;
+
+  nodes = realloc(nodes, (n_nodes + 1) * sizeof(*nodes));
+  n = &nodes[n_nodes++];
+  memset(n, 0, sizeof(*n));
+  n->role = role;
+  n->id = id;
+  n->field = field;
+  n->x = x;
+  n->y = y;
+  n->wake_at = SIM_TIME_NEVER;
+  n->radio_on = 1;
+  return n;
+}
+
+static void
+add_nbr(struct node *n, uint32_t other, double dist)
+{
+  if(n->n_nbrs == n->cap_nbrs) {
+    n->cap_nbrs = n->cap_nbrs ? n->cap_nbrs * 2 : 8;
+    n->nbrs = realloc(n->nbrs, n->cap_nbrs * sizeof(*n->nbrs));
+  }
+  n->nbrs[n->n_nbrs++] = (struct nbr){ other, dist <= tx_range,
+                                       (float)(dist / tx_range) };
+}
+
+static void
+link_nodes(void)
+{
+  uint32_t i, j;
+
+  /* nodes are added field by field, so only compare within a field */
+  for(i = 0; i < n_nodes; i++) {
+    for(j = i + 1; j < n_nodes && nodes[j].field == nodes[i].field; j++) {
+      double d = hypot(nodes[i].x - nodes[j].x, nodes[i].y - nodes[j].y);
+      if(d <= int_range) {
+        add_nbr(&nodes[i], j, d);
+        add_nbr(&nodes[j], i, d);
+      }
+    }
+  }
+}
+
+static double
+xml_number(const char *line, const char *tag)
+{
+  const char *p = strstr(line, tag);
+
+  return p ? atof(p + strlen(tag)) : NAN;
+}
+
+/* Motes, roles, positions and radio ranges of a Cooja .csc file */
+static void
+load_csc(const char *path)
+{
+  char line[512];
+  enum role role = ROLE_SENSOR;
+  double x = 0, y = 0, v;
+  FILE *f = fopen(path, "r");
+
+  if(f == NULL) {
+    die("%s: %s", path, strerror(errno));
+  }
+  while(fgets(line, sizeof(line), f)) {
+    if(strstr(line, "<source>")) {
+      role = strstr(line, "border") ? ROLE_BORDER
+           : strstr(line, "computation") ? ROLE_COMPUTATION : ROLE_SENSOR;
+    } else if(!isnan(v = xml_number(line, "<transmitting_range>"))) {
+      tx_range = v;
+    } else if(!isnan(v = xml_number(line, "<interference_range>"))) {
+      int_range = v;
+    } else if(!isnan(v = xml_number(line, "<success_ratio_rx>"))) {
+      success_ratio = v;
+    } else if(strstr(line, "<pos ")) {
+      x = xml_number(line, "x=\"");
+      y = xml_number(line, "y=\"");
+    } else if(!isnan(v = xml_number(line, "<id>"))) {
+      add_node(role, (uint8_t)v, 0, x, y);
+    }
+  }
+  fclose(f);
+}
+
+/* A random field per network: border router in the middle, then
+   one computation node for every six motes, the rest sensors */
+static void
+generate(uint32_t per_field)
+{
+  double side = sqrt(per_field * M_PI * tx_range * tx_range / 8.0);
+  uint16_t field;
+  uint32_t i, n_comp = per_field / 6 ? per_field / 6 : 1;
+
+  for(field = 0; field < n_fields; field++) {
+    add_node(ROLE_BORDER, 1, field, side / 2, side / 2);
+    for(i = 2; i <= per_field; i++) {
+      add_node(i <= 1 + n_comp ? ROLE_COMPUTATION : ROLE_SENSOR, i, field,
+               rng_unit() * side, rng_unit() * side);
+    }
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+open_logs(const char *path)
+{
+  uint16_t i;
+
+  field_logs = calloc(n_fields, sizeof(*field_logs));
+  for(i = 0; i < n_fields; i++) {
+    char name[512];
+    if(quiet) {
+      continue;
+    }
+    if(path == NULL) {
+      field_logs[i] = stdout;
+      continue;
+    }
+    if(n_fields == 1) {
+      snprintf(name, sizeof(name), "%s", path);
+    } else {
+      snprintf(name, sizeof(name), "%s.%u", path, i);
+    }
+    field_logs[i] = fopen(name, "w");
+    if(field_logs[i] == NULL) {
+      die("%s: %s", name, strerror(errno));
+    }
+  }
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr,
+          "usage: sim [-c file.csc | -n nodes [-f fields]] [-t seconds]\n"
+          "           [-s seed] [-r range] [-p success_ratio] [-o log] [-q]\n"
+          "           [-k id:seconds]...\n");
+  exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *csc = NULL, *log_path = NULL;
+  uint32_t per_field = 0, i;
+  double duration = 7200;
+  uint64_t end_us, seed = 1;
+  struct timespec w0, w1;
+  int opt, r;
+  struct { unsigned id; double at; } kills[16];
+  unsigned n_kills = 0, k;
+
+  while((opt = getopt(argc, argv, "c:n:f:t:s:r:p:o:qk:")) != -1) {
+    switch(opt) {
+    case 'c': csc = optarg; break;
+    case 'n': per_field = strtoul(optarg, NULL, 0); break;
+    case 'f': n_fields = strtoul(optarg, NULL, 0); break;
+    case 't': duration = atof(optarg); break;
+    case 's': seed = strtoull(optarg, NULL, 0); break;
+    case 'r': tx_range = atof(optarg); int_range = 2 * tx_range; break;
+    case 'p': success_ratio = atof(optarg); break;
+    case 'o': log_path = optarg; break;
+    case 'q': quiet = 1; break;
+    case 'k':
+      if(n_kills == 16
+         || sscanf(optarg, "%u:%lf", &kills[n_kills].id,
+                   &kills[n_kills].at) != 2) {
+        usage();
+      }
+      n_kills++;
+      break;
+    default: usage();
+    }
+  }
+  rng_state ^= seed * 0x9E3779B97F4A7C15ULL;
+  if(csc != NULL) {
+    n_fields = 1;
+    load_csc(csc);
+  } else {
+    if(per_field < 2 || per_field > MAX_FIELD_NODES || n_fields == 0) {
+      usage();
+    }
+    generate(per_field);
+  }
+  if(n_nodes == 0) {
+    die("no motes");
+  }
+  link_nodes();
+  open_logs(log_path);
+
+  /* every node starts from the role's initial memory image */
+  for(r = 0; r < ROLE_COUNT; r++) {
+    const struct mote_api *api = role_api[r];
+    roles[r].data_len = api->data_end - api->data_start;
+    roles[r].bss_len = api->bss_end - api->bss_start;
+    roles[r].pristine = malloc(roles[r].data_len + roles[r].bss_len);
+    memcpy(roles[r].pristine, api->data_start, roles[r].data_len);
+    memcpy(roles[r].pristine + roles[r].data_len, api->bss_start,
+           roles[r].bss_len);
+  }
+  for(i = 0; i < n_nodes; i++) {
+    struct role_mem *rm = &roles[nodes[i].role];
+    nodes[i].image = malloc(rm->data_len + rm->bss_len);
+    memcpy(nodes[i].image, rm->pristine, rm->data_len + rm->bss_len);
+    schedule(rng() % 1000000, EV_BOOT, i, NULL);
+    for(k = 0; k < n_kills; k++) {
+      if(nodes[i].id == kills[k].id) {
+        schedule((uint64_t)(kills[k].at * 1e6), EV_KILL, i, NULL);
+      }
+    }
+  }
+
+  end_us = (uint64_t)(duration * 1e6);
+  clock_gettime(CLOCK_MONOTONIC, &w0);
+  while(heap_len > 0 && heap[0].t <= end_us) {
+    struct event e = next_event();
+    struct node *n = &nodes[e.node];
+
+    now_us = e.t;
+    stats.events++;
+    switch(e.type) {
+    case EV_BOOT:
+      if(n->dead) {
+        break;
+      }
+      n->on_since = now_us;
+      activate(n);
+      role_api[n->role]->boot(n->id, (uint16_t)rng());
+      settle(n);
+      break;
+    case EV_WAKE:
+      if(e.t != n->wake_at) {
+        break;                  /* superseded */
+      }
+      n->wake_at = SIM_TIME_NEVER;
+      activate(n);
+      settle(n);
+      break;
+    case EV_TX_START:
+      if(n->dead) {
+        mac_next(n);
+        break;
+      }
+      tx_start(n, e.ptr);
+      break;
+    case EV_KILL:
+      /* a node failure: no more timers, frames or receptions */
+      current = n;
+      sim_radio_set(0);
+      n->dead = 1;
+      n->wake_at = SIM_TIME_NEVER;
+      if(field_logs[n->field] != NULL) {
+        print_time(field_logs[n->field], now_us);
+        fprintf(field_logs[n->field], "\tID:%u\tSIM : Node %u: killed\n",
+                n->id, n->id);
+      }
+      break;
+    case EV_TX_END:
+      tx_end(n, e.ptr);
+      break;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &w1);
+
+  for(i = 0; i < n_fields; i++) {
+    if(field_logs[i] != NULL) {
+      fflush(field_logs[i]);
+    }
+  }
+  {
+    double wall = (w1.tv_sec - w0.tv_sec) + (w1.tv_nsec - w0.tv_nsec) / 1e9;
+    fprintf(stderr,
+            "SIM : %u nodes in %u field(s), %.0f s simulated in %.2f s "
+            "(x%.0f)\n"
+            "SIM : %llu events, %llu wake-ups, %llu log lines\n"
+            "SIM : %llu frames (%llu B), %llu deliveries, %llu collisions, "
+            "%llu retries, %llu MAC drops\n"
+            "SIM : mote image %zu/%zu/%zu bytes (sensor/computation/border)\n",
+            n_nodes, n_fields, duration, wall,
+            wall > 0 ? duration / wall : 0.0,
+            (unsigned long long)stats.events,
+            (unsigned long long)stats.wakeups,
+            (unsigned long long)stats.lines,
+            (unsigned long long)stats.frames,
+            (unsigned long long)stats.bytes,
+            (unsigned long long)stats.deliveries,
+            (unsigned long long)stats.collisions,
+            (unsigned long long)stats.retries,
+            (unsigned long long)stats.mac_drops,
+            roles[ROLE_SENSOR].data_len + roles[ROLE_SENSOR].bss_len,
+            roles[ROLE_COMPUTATION].data_len
+            + roles[ROLE_COMPUTATION].bss_len,
+            roles[ROLE_BORDER].data_len + roles[ROLE_BORDER].bss_len);
+  }
+  return 0;
+}
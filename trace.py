@@ -0,0 +1,177 @@
+# trace.py
+# End-to-end latency from the TRACE lines of Cooja or sim logs.
+#
+# Firmware built with TRACE_CONF_ENABLED=1 logs one line per stage, e.g.
+#   "TRACE : Node 1: server 24/7 hops=3 state=1 age=5312 ms"
+# server / compute: reading 7 of sensor 24 reached a border router / a
+#   computation node over 3 links, 5.3 s after it was sampled in LPM.
+# act: a command (issuer/seq) reached its sensor over `hops` links down;
+#   the age runs from the reading that prompted it, or from the border
+#   router sending it when the server issued it.
+#
+# Latencies are grouped per path and then by hop count, by the origin's
+# power state and by the power state of the node logging the stage:
+#
+#   python3 trace.py run.txt
+#   python3 trace.py --by hops --format json run-*.txt
+import argparse
+import csv
+import json
+import re
+import sys
+from collections import defaultdict
+
+TRACE_RE = re.compile(
+    rb"TRACE : Node \d+: (\w+) (\d+)/(\d+) hops=(\d+) state=(\d+) "
+    rb"age=(\d+) ms")
+MODE_RE = re.compile(rb"MODE : Node \d+: (WAKE|LPM|DEEP LPM)")
+
+STATES = ["ACTIVE", "LPM", "DEEP LPM"]
+MODE_STATE = {b"WAKE": "ACTIVE", b"LPM": "LPM", b"DEEP LPM": "DEEP LPM"}
+
+# What each stage measures; act splits on who issued the command
+PATHS = {
+    "server": "sample->border",
+    "compute": "sample->computation",
+    "act": "sample->valve",
+    "act_root": "server cmd->valve",
+}
+
+BREAKDOWNS = ("hops", "state", "at")
+
+
+def percentile(sorted_ms, p):
+    """Nearest-rank percentile of a sorted list."""
+    k = max(0, -(-len(sorted_ms) * p // 100) - 1)
+    return sorted_ms[int(k)]
+
+
+def histogram(sorted_ms):
+    """Counts per power-of-two bucket, keyed by the bucket's upper bound."""
+    hist = defaultdict(int)
+    for ms in sorted_ms:
+        hist[1 << max(ms, 1).bit_length()] += 1
+    return {str(k): hist[k] for k in sorted(hist)}
+
+
+def before(field, until):
+    """Whether the '[h:]mm:ss.mmm' timestamp is at most `until` seconds."""
+    parts = field.split(b":")
+    try:
+        secs = sum(float(p) * 60 ** i for i, p in enumerate(reversed(parts)))
+    except ValueError:
+        return True
+    return secs <= until
+
+
+def collect(paths, until=None):
+    """{(path, breakdown, key): [ms, ...]} over all logs."""
+    groups = defaultdict(list)
+    for path in paths:
+        roots = set()
+        state = {}
+        with open(path, "rb") as f:
+            for line in f:
+                parts = line.split(b"\t", 2)
+                if len(parts) < 3 or not parts[1].startswith(b"ID:"):
+                    continue
+                if until is not None and not before(parts[0], until):
+                    break
+                node = int(parts[1][3:])
+                msg = parts[2]
+                if msg.startswith(b"MODE"):
+                    m = MODE_RE.match(msg)
+                    if m:
+                        state[node] = MODE_STATE[m.group(1)]
+                    continue
+                if b"I am root" in msg:
+                    roots.add(node)
+                    continue
+                if not msg.startswith(b"TRACE"):
+                    continue
+                m = TRACE_RE.match(msg)
+                if not m:
+                    continue
+                stage = m.group(1).decode()
+                if stage == "act" and int(m.group(2)) in roots:
+                    stage = "act_root"
+                if stage not in PATHS:
+                    continue
+                name = PATHS[stage]
+                ms = int(m.group(6))
+                origin = int(m.group(5))
+                keys = {
+                    "hops": int(m.group(4)),
+                    "state": STATES[origin] if origin < 3 else str(origin),
+                    "at": state.get(node, "ACTIVE"),
+                }
+                groups[(name, "all", "")].append(ms)
+                for by, key in keys.items():
+                    groups[(name, by, key)].append(ms)
+    return groups
+
+
+def summarise(groups, breakdowns):
+    rows = []
+    for (name, by, key), ms in groups.items():
+        if by != "all" and by not in breakdowns:
+            continue
+        ms.sort()
+        rows.append({
+            "path": name, "by": by, "key": key, "n": len(ms),
+            "p50_ms": percentile(ms, 50), "p99_ms": percentile(ms, 99),
+            "max_ms": ms[-1], "hist": histogram(ms),
+        })
+    order = {b: i for i, b in enumerate(("all",) + BREAKDOWNS)}
+    rows.sort(key=lambda r: (r["path"], order[r["by"]],
+                             (0, r["key"]) if isinstance(r["key"], int)
+                             else (1, r["key"])))
+    return rows
+
+
+def write_text(rows, out):
+    out.write("%-20s %-6s %-9s %7s %9s %9s %9s\n"
+              % ("path", "by", "key", "n", "p50_ms", "p99_ms", "max_ms"))
+    for r in rows:
+        out.write("%-20s %-6s %-9s %7d %9d %9d %9d\n"
+                  % (r["path"], r["by"], r["key"], r["n"], r["p50_ms"],
+                     r["p99_ms"], r["max_ms"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Latency percentiles per path, hop count and power "
+                    "state from TRACE lines")
+    parser.add_argument("logs", nargs="+", help="Cooja or sim log files")
+    parser.add_argument("--until", type=float, default=None,
+                        help="ignore lines after this many simulated seconds")
+    parser.add_argument("--by", default=",".join(BREAKDOWNS),
+                        help="breakdowns to show, out of %s (default: all)"
+                             % ",".join(BREAKDOWNS))
+    parser.add_argument("--format", choices=("text", "json", "csv"),
+                        default="text")
+    args = parser.parse_args()
+
+    breakdowns = [b for b in args.by.split(",") if b]
+    for b in breakdowns:
+        if b not in BREAKDOWNS:
+            parser.error("unknown breakdown %r" % b)
+
+    rows = summarise(collect(args.logs, args.until), breakdowns)
+    if not rows:
+        sys.exit("no TRACE lines: build with TRACE_CONF_ENABLED=1")
+    if args.format == "json":
+        json.dump(rows, sys.stdout, indent=1)
+        sys.stdout.write("\n")
+    elif args.format == "csv":
+        w = csv.writer(sys.stdout)
+        w.writerow(["path", "by", "key", "n", "p50_ms", "p99_ms", "max_ms"])
+        for r in rows:
+            w.writerow([r[k] for k in ("path", "by", "key", "n", "p50_ms",
+                                       "p99_ms", "max_ms")])
+    else:
+        write_text(rows, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()